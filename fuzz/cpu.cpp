@@ -0,0 +1,89 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "emulator.hpp"
+
+// Fuzzing entry point for the CPU. The first bytes of the input give the
+// initial state of the registers and the rest is copied into RAM, which is
+// all there is on the bus without a cartridge. Two emulators run the same
+// input side by side, and they must agree on every instruction. Only the
+// subject fetches instructions through the CPU's fetch window, which must
+// not make any difference.
+
+#define FUZZ_CHECK(cond) do { \
+    if(!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while(0)
+
+// How many instructions to run per input at most
+static const int max_steps = 4096;
+
+static bool same_state(const nes::CpuState &a, const nes::CpuState &b) {
+    return a.pc == b.pc && a.acc == b.acc && a.x == b.x && a.y == b.y
+        && a.stack_ptr == b.stack_ptr && a.status == b.status
+        && a.cycles == b.cycles;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if(size < 7) return 0;
+    nes::CpuState state;
+    state.acc = data[0];
+    state.x = data[1];
+    state.y = data[2];
+    state.stack_ptr = data[3];
+    state.status = data[4];
+    state.pc = (data[5] | data[6] << 8) & 0x07FF;
+    data += 7;
+    size -= 7;
+
+    nes::Emulator reference, subject;
+    for(size_t i = 0; i < size && i < 0x0800; ++i) {
+        reference.write(i, data[i]);
+        subject.write(i, data[i]);
+    }
+    reference.set_fetch_window(false);
+    reference.set_cpu_state(state);
+    subject.set_cpu_state(state);
+
+    for(int i = 0; i < max_steps; ++i) {
+        uint64_t cycles = reference.get_cpu_state().cycles;
+        reference.step();
+        subject.step();
+        nes::CpuState after = reference.get_cpu_state();
+        // Every instruction takes between 2 and 7 cycles (8 for some of the
+        // illegal ones), and nothing else may make time go by
+        FUZZ_CHECK(after.cycles - cycles >= 2 && after.cycles - cycles <= 8);
+        FUZZ_CHECK(same_state(after, subject.get_cpu_state()));
+        FUZZ_CHECK(reference.hash_ram() == subject.hash_ram());
+    }
+
+    // Then run both in one go for a while, with idle loop skipping only in
+    // the subject, which must not make any difference either
+    reference.set_idle_skipping(false);
+    uint64_t until = reference.get_cpu_state().cycles + 8 * max_steps;
+    FUZZ_CHECK(reference.run_until(until) == subject.run_until(until));
+    FUZZ_CHECK(same_state(reference.get_cpu_state(), subject.get_cpu_state()));
+    FUZZ_CHECK(reference.hash_ram() == subject.hash_ram());
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Stand-alone driver for the fuzzing entry points, for when libFuzzer is not
+// available. It runs each file given on the command line through the entry
+// point, or standard input if there are none, which is how AFL feeds its
+// inputs. It is also handy for reproducing crashes under a debugger.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void run(std::istream &in) {
+    std::vector<uint8_t> input((std::istreambuf_iterator<char>(in)),
+            std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        run(std::cin);
+        return 0;
+    }
+    for(int i = 1; i < argc; ++i) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if(!file) {
+            std::cerr << "Could not open " << argv[i] << '\n';
+            return 1;
+        }
+        run(file);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "disassembler.hpp"
+#include "emulator.hpp"
+#include "recompiler.hpp"
+
+// Fuzzing entry point for the recompiler. The first bytes of the input give
+// the initial state of the registers, the next ones go into program RAM at
+// $6000 and the rest is the program ROM of a cartridge. Everything reachable
+// from the initial PC is recompiled, program RAM included (as tiered
+// execution would), and the result runs side by side with the interpreter,
+// with which it must agree at every step. Code in program RAM that gets
+// overwritten, by either of them, must be dropped in time.
+//
+// Each input goes through the system's compiler, so this is slow going
+// compared to the other harnesses; what it finds makes up for that.
+
+#define FUZZ_CHECK(cond) do { \
+    if(!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while(0)
+
+// Bytes of program RAM the input fills in, which keeps the number of blocks
+// compiled from it (one at every instruction) down
+static const size_t ram_code_size = 64;
+
+// How many CPU cycles to run per input, and how many at a time between checks
+static const uint64_t max_cycles = 1 << 15, cycles_per_check = 64;
+
+static bool same_state(const nes::CpuState &a, const nes::CpuState &b) {
+    return a.pc == b.pc && a.acc == b.acc && a.x == b.x && a.y == b.y
+        && a.stack_ptr == b.stack_ptr && a.status == b.status
+        && a.cycles == b.cycles;
+}
+
+// Scratch directory for the modules, removed on the way out
+static const std::string &scratch_dir() {
+    static std::string dir;
+    if(dir.empty()) {
+        char name[] = "/tmp/libre-nes-fuzz-XXXXXX";
+        FUZZ_CHECK(mkdtemp(name));
+        dir = name;
+        atexit([] { rmdir(dir.c_str()); });
+    }
+    return dir;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if(size < 7 + ram_code_size + 1) return 0;
+    nes::CpuState state;
+    state.acc = data[0];
+    state.x = data[1];
+    state.y = data[2];
+    state.stack_ptr = data[3];
+    state.status = data[4];
+    uint16_t entry = data[5] | data[6] << 8;
+    const uint8_t *ram_code = data + 7;
+    data += 7 + ram_code_size;
+    size -= 7 + ram_code_size;
+
+    // A 16KiB NROM cartridge, mirrored at $C000, padded with NOPs
+    std::vector<uint8_t> image(16 + 0x4000, 0xEA);
+    const uint8_t header[16] = { 'N', 'E', 'S', 0x1A, 0x01 };
+    std::copy(header, header + 16, image.begin());
+    std::copy(data, data + std::min<size_t>(size, 0x4000), image.begin() + 16);
+    // Start in program RAM or ROM, wherever the input put code
+    size_t code_size = ram_code_size + std::min<size_t>(size, 0x4000);
+    entry %= code_size;
+    state.pc = entry < ram_code_size ? 0x6000 + entry : 0x8000 + entry - ram_code_size;
+
+    nes::Emulator reference, subject;
+    for(nes::Emulator *nes_emu : { &reference, &subject }) {
+        FUZZ_CHECK(nes_emu->load_rom(image.data(), image.size()));
+        for(size_t i = 0; i < ram_code_size; ++i)
+            nes_emu->write(0x6000 + i, ram_code[i]);
+        nes_emu->set_cpu_state(state);
+    }
+
+    // Compile everything reachable, like libre-nes-aot for program ROM and
+    // like the tiered compiler for program RAM
+    nes::Disassembler disassembler(subject);
+    disassembler.add_entry(state.pc);
+    const std::vector<nes::Instruction> &listing = disassembler.disassemble();
+    std::vector<nes::CodeBlock> blocks = nes::find_blocks(subject, listing);
+    for(const nes::Instruction &inst : listing) {
+        if(inst.addr < 0x6000 || inst.addr >= 0x8000) continue;
+        nes::CodeBlock block = nes::decode_block(subject, inst.addr);
+        if(!block.instructions.empty()) blocks.push_back(std::move(block));
+    }
+    if(blocks.empty()) return 0;
+    std::string source = scratch_dir() + "/module.cpp", module = scratch_dir() + "/module.so";
+    std::ofstream(source) << nes::emit_module(blocks, subject.hash_prg_rom());
+    FUZZ_CHECK(nes::compile_module(source, module, nes::default_compiler(),
+                nes::default_include_dir()));
+    FUZZ_CHECK(subject.load_native(module));
+    remove(source.c_str());
+    remove(module.c_str());
+
+    // Native blocks only run when they end before the given cycle, so both
+    // stop on the same instruction every time
+    reference.set_idle_skipping(false);
+    subject.set_idle_skipping(false);
+    for(uint64_t ran = 0; ran < max_cycles; ran += cycles_per_check) {
+        uint64_t until = reference.get_cpu_state().cycles + cycles_per_check;
+        FUZZ_CHECK(reference.run_until(until) == subject.run_until(until));
+        FUZZ_CHECK(same_state(reference.get_cpu_state(), subject.get_cpu_state()));
+        FUZZ_CHECK(reference.hash_ram() == subject.hash_ram());
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include "emulator.hpp"
+
+// Fuzzing entry point for the iNES loader and the cartridge. Whatever the
+// input is, loading it must either fail cleanly or give us something that can
+// be run for a frame without reading out of bounds.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    nes::Emulator nes_emu;
+    if(nes_emu.load_rom(data, size))
+        nes_emu.run_frame();
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_AOT_ABI_H
+#define NES_AOT_ABI_H
+
+#include <stdint.h>
+
+/* Interface between the emulator and modules of natively compiled 6502 code,
+   as generated by the recompiler (see recompiler.hpp). It is plain C, so that
+   modules depend on nothing but this header. A module is a shared object
+   exporting a nes_aot_module called nes_aot_module_info, which lists blocks
+   of straight line code, each compiled into a function. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a change breaks compatibility with existing modules */
+#define NES_AOT_ABI_VERSION 2
+
+/* The state a block works on. Blocks take it as an argument rather than
+   touching anything global, so the same code serves any emulator */
+typedef struct nes_aot_context {
+    /* Registers, updated by the block. The PC is set to wherever it left off */
+    uint16_t pc;
+    uint8_t a, x, y, sp, p;
+
+    /* The 2KiB of RAM, which blocks access directly whenever they can tell
+       an access goes there. Every write also increments side_effects and
+       ram_writes */
+    uint8_t *ram;
+    uint64_t *side_effects;
+    uint64_t *ram_writes;
+
+    /* Everything else goes through the bus */
+    void *bus;
+    uint8_t (*read)(void *bus, uint16_t addr);
+    void (*write)(void *bus, uint16_t addr, uint8_t data);
+} nes_aot_context;
+
+typedef void (*nes_aot_block)(nes_aot_context *ctx);
+
+typedef struct nes_aot_block_info {
+    /* Address of the block's first instruction, and size of its code */
+    uint16_t addr;
+    uint16_t size;
+    /* Number of instructions in the block, and the cycles they take */
+    uint16_t instructions;
+    uint16_t cycles;
+    nes_aot_block run;
+} nes_aot_block_info;
+
+typedef struct nes_aot_module {
+    uint32_t abi_version;
+    /* Hash of the program ROM the module was compiled from */
+    uint64_t rom_hash;
+    uint32_t block_count;
+    const nes_aot_block_info *blocks;
+} nes_aot_module;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NES_AOT_ABI_H */
@@ -0,0 +1,112 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_CARTRIDGE_HPP
+#define NES_CARTRIDGE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// This class represents the game cartridge plugged into the console. For now,
+// only the simplest kind of board is supported: NROM (mapper 0), which has
+// either 16KiB or 32KiB of program ROM and no bank switching whatsoever. We
+// also give it 8KiB of program RAM at $6000-$7FFF, as most emulators do: few
+// NROM games use it, but test ROMs report their results through it.
+
+namespace nes {
+    class Cartridge {
+        public:
+            // Load a cartridge from an image in the iNES format. Returns
+            // false if the image is malformed or uses an unsupported mapper
+            bool load(const uint8_t *image, size_t size);
+
+            // Whether a cartridge is currently loaded
+            bool is_loaded() const { return !prg_rom.empty(); }
+
+            // Read from the cartridge's address space ($6000-$FFFF)
+            uint8_t read(uint16_t addr) const;
+
+            // Write to the cartridge's address space ($6000-$FFFF). Only
+            // program RAM is actually writable
+            void write(uint16_t addr, uint8_t data);
+
+            // The 256 byte page of program RAM or ROM holding the given
+            // address ($6000-$FFFF), as the CPU sees it. Reading from it is
+            // the same as calling read(), until the next patch
+            const uint8_t *page(uint16_t addr) const {
+                if(addr < 0x8000) return prg_ram.data() + (addr & 0x1F00);
+                return prg_pages[(addr >> 8) & (page_count - 1)];
+            }
+
+            // Patch a byte of program ROM as seen by the CPU at the given
+            // address ($8000-$FFFF), if it currently holds the compare value
+            // (or regardless, if compare is -1). Returns false if it doesn't
+            bool patch(uint16_t addr, uint8_t value, int compare = -1);
+
+            // Undo all patches
+            void clear_patches();
+
+            // Whether any of program ROM is patched
+            bool is_patched() const { return !patched_pages.empty(); }
+
+            // Whether the 256 byte page of program ROM holding the given
+            // address ($8000-$FFFF) is patched
+            bool is_patched(uint16_t addr) const {
+                return patched_pages.count((addr >> 8) & (page_count - 1)) != 0;
+            }
+
+            // The program ROM, as it is in the image (without patches)
+            const std::vector<uint8_t> &get_prg_rom() const { return prg_rom; }
+
+            // Direct access to program RAM, for inspection and save states
+            std::array<uint8_t, 0x2000> &get_prg_ram() { return prg_ram; }
+            const std::array<uint8_t, 0x2000> &get_prg_ram() const { return prg_ram; }
+
+        private:
+            // Program ROM, containing the game's code and data. If there is
+            // only 16KiB of it, it is mirrored in the upper half of the space
+            std::vector<uint8_t> prg_rom;
+
+            // Character ROM, containing graphics data for the PPU. It is not
+            // used by anything yet, but it is part of the image
+            std::vector<uint8_t> chr_rom;
+
+            // Program RAM, mapped to $6000-$7FFF
+            std::array<uint8_t, 0x2000> prg_ram {};
+
+            // Mask applied to addresses to get an offset into program ROM,
+            // which takes care of the mirroring mentioned above
+            uint16_t prg_mask = 0;
+
+            // Program ROM as seen by the CPU, in 256 byte pages from $8000 up.
+            // Each page points into prg_rom, unless it was patched, in which
+            // case it points to a patched copy instead. That way, patches cost
+            // nothing on reads, and pages without them stay as they were
+            static const unsigned page_count = 0x80;
+            std::array<const uint8_t*, page_count> prg_pages {};
+
+            // The patched copies, by page number. Their addresses are stable,
+            // which the page table relies on
+            std::map<unsigned, std::array<uint8_t, 0x100>> patched_pages;
+    };
+}
+
+#endif // NES_CARTRIDGE_HPP
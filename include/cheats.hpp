@@ -0,0 +1,47 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_CHEATS_HPP
+#define NES_CHEATS_HPP
+
+#include <cstdint>
+#include <string>
+
+// Cheat codes. Two kinds are supported: Game Genie codes, which patch the
+// program ROM as seen by the CPU (6 letters, or 8 with a compare value), and
+// raw codes in the form AAAA:VV, which either patch ROM (for addresses from
+// $8000 up) or freeze a value in RAM, by writing it again every frame.
+
+namespace nes {
+    struct Cheat {
+        uint16_t addr = 0;
+        uint8_t value = 0;
+
+        // For ROM patches, the value that has to be in ROM for the patch to
+        // apply, or -1 if there is none
+        int compare = -1;
+
+        // Whether the cheat patches ROM, rather than freezing RAM
+        bool is_rom_patch() const { return addr >= 0x8000; }
+    };
+
+    // Parse a cheat code of either kind. Returns false if it is malformed
+    bool parse_cheat(const std::string &code, Cheat &cheat);
+}
+
+#endif // NES_CHEATS_HPP
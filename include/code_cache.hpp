@@ -0,0 +1,89 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_CODE_CACHE_HPP
+#define NES_CODE_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+
+// An on-disk cache for tiered execution (see tiering.hpp), so that running
+// the same game again doesn't start from scratch. For each ROM it keeps a map
+// of which code in program ROM got hot, which is mapped back into memory on
+// the next run so that code can be compiled right away, without waiting for
+// it to get hot again. Modules compiled that way are kept too, named after a
+// hash of their source (and compiler command): whenever the same code is
+// recompiled into the same source, the module is simply loaded back, and a
+// change to the recompiler, the code or the compiler makes for a new name,
+// so a stale module is never picked up.
+//
+// Several processes can share the same cache directory. Code in program RAM
+// is never cached, as it is only there once the game puts it there.
+
+namespace nes {
+    // Layout of a ROM's map of hot code
+    struct CodeMap {
+        char magic[8];
+        uint32_t version;
+        uint32_t abi_version;
+        uint64_t rom_hash;
+        // Nonzero for every address in program ROM ($8000 up) that started
+        // a block which got hot
+        uint8_t hot[0x8000];
+    };
+
+    class CodeCache {
+        public:
+            // Open the cache for the ROM with the given hash in the given
+            // directory, which is created if it doesn't exist yet
+            CodeCache(const std::string &dir, uint64_t rom_hash);
+            ~CodeCache();
+
+            CodeCache(const CodeCache&) = delete;
+            CodeCache &operator=(const CodeCache&) = delete;
+
+            // Whether the cache could be opened
+            bool ok() const { return map != nullptr; }
+
+            // Whether the block at the given address got hot on an earlier run
+            bool was_hot(uint16_t addr) const {
+                return addr >= 0x8000 && map->hot[addr - 0x8000];
+            }
+
+            // Remember the block at the given address as hot
+            void mark_hot(uint16_t addr) {
+                if(addr >= 0x8000) map->hot[addr - 0x8000] = 1;
+            }
+
+            // Where the module compiled from the given source with the given
+            // compiler command is or would be kept
+            std::string module_path(const std::string &source, const std::string &compiler) const;
+
+            // Move a freshly compiled module to where it is kept, dropping
+            // the ones compiled before it for the same ROM, which it
+            // supersedes. Returns false if it couldn't be moved
+            bool store(const std::string &compiled, const std::string &path);
+
+        private:
+            // Cache files for a ROM are named after its hash
+            std::string dir, prefix;
+            CodeMap *map = nullptr;
+    };
+}
+
+#endif // NES_CODE_CACHE_HPP
@@ -0,0 +1,42 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_CPU_PRINT_HPP
+#define NES_CPU_PRINT_HPP
+
+#include "processor.hpp"
+
+namespace nes { class Emulator; }
+
+// Human readable printouts of the state of the processor. These used to be
+// methods of the processor itself; now they are built on top of the state
+// accessors, so that nothing has to format text (and parse it back) just to
+// look at the registers.
+
+namespace nes {
+    // Show the current state of all registers
+    void show_registers(const CpuState &state);
+
+    // Show the next instruction to be executed
+    void show_opcode(const Emulator &nes_emu);
+
+    // Show values on the stack, from top to bottom
+    void show_stack(const StackView &stack);
+}
+
+#endif // NES_CPU_PRINT_HPP
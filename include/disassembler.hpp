@@ -0,0 +1,127 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_DISASSEMBLER_HPP
+#define NES_DISASSEMBLER_HPP
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "opcodes.hpp"
+
+namespace nes { class Emulator; }
+
+// Disassembly of the code on the bus, built on top of the opcode table. Apart
+// from decoding single instructions, the disassembler can find all of the code
+// that is reachable from the reset, NMI and IRQ vectors (plus any other entry
+// points it is given), by following the control flow from them. Both decoded
+// and traced instructions are kept per 4KiB bank, and a bank is only traced
+// again when the emulator tells its contents may have changed (see
+// Emulator::get_bank_version), or when it depends on one that did: because
+// the flow of control came from there, or because an instruction or a jump
+// pointer was read from there. So repeated disassembly only costs as much as
+// the code affected by whatever was written since the previous one, plus
+// copying the listing together if anything did change.
+
+namespace nes {
+    // A single decoded instruction
+    struct Instruction {
+        uint16_t addr = 0;
+        uint8_t opcode = 0;
+        uint8_t operand[2] = {};
+        uint8_t size = 1;
+
+        const OpcodeInfo &info() const { return opcode_table[opcode]; }
+
+        // The operand as a single value (one or two bytes, little endian)
+        uint16_t value() const { return operand[0] | operand[1] << 8; }
+
+        // Where a branch, JMP or JSR goes to (meaningless for anything else)
+        uint16_t target() const;
+    };
+
+    // Decode the instruction at the given address, without side effects
+    Instruction decode(const Emulator &nes_emu, uint16_t addr);
+
+    // Format an instruction in the usual assembler syntax, e.g. "LDA ($10),Y".
+    // Illegal opcodes are marked with an asterisk
+    std::string format(const Instruction &inst);
+
+    class Disassembler {
+        public:
+            Disassembler(const Emulator &nes_emu) : nes_emu(nes_emu) {}
+
+            // Add an entry point to follow, besides the interrupt vectors
+            void add_entry(uint16_t addr);
+
+            // Get every instruction reachable from the entry points, sorted
+            // by address. The listing stays valid until the next call
+            const std::vector<Instruction> &disassemble();
+
+        private:
+            const Emulator &nes_emu;
+
+            static const int bank_size = 0x1000;
+            static const int bank_count = 0x10000 / bank_size;
+
+            // What we know of each bank: the instructions decoded from it,
+            // by address, valid as long as the bank's version stays the same,
+            // and those reached by tracing, which are valid as long as that of
+            // the banks set in depends (besides this one) stay the same too
+            struct Bank {
+                bool valid = false;
+                uint64_t version = 0;
+                std::unordered_map<uint16_t, Instruction> decoded;
+
+                uint16_t depends = 0;
+                std::bitset<bank_size> visited;
+                std::vector<Instruction> listing;
+                // Where the flow of control left for other banks
+                std::vector<uint16_t> exits;
+            };
+            std::array<Bank, bank_count> banks;
+
+            std::vector<uint16_t> entries;
+            // The interrupt vectors the banks were traced from
+            std::array<uint16_t, 3> vectors {};
+            std::vector<Instruction> listing;
+            // Whether there are entry points that weren't followed yet
+            bool new_entries = false;
+
+            // Check every bank for changes, dropping the decoded instructions
+            // of the ones that changed. Returns a mask of the ones that did
+            uint16_t refresh_banks();
+
+            // Decode an instruction, going through the bank caches
+            const Instruction &decode_cached(uint16_t addr);
+
+            // Drop the traced instructions of the given banks, and those of
+            // every bank that depends on them. Returns the whole set dropped
+            uint16_t untrace(uint16_t changed);
+
+            // Follow the control flow from the given addresses, as far as it
+            // goes without running into something already traced. Returns a
+            // mask of the banks that got new instructions
+            uint16_t trace(std::vector<uint16_t> pending);
+    };
+}
+
+#endif // NES_DISASSEMBLER_HPP
@@ -20,8 +20,17 @@
 #define NES_EMULATOR_HPP
 
 #include <array>
+#include <memory>
+#include <string>
 #include <vector>
+#include "cartridge.hpp"
+#include "cheats.hpp"
+#include "hooks.hpp"
+#include "native_module.hpp"
 #include "processor.hpp"
+#include "recorder.hpp"
+#include "shared_export.hpp"
+#include "tiering.hpp"
 
 // This class represents both the console itself, holding a list of its major
 // components, and the main data bus, which is used by these components to
@@ -37,15 +46,206 @@ namespace nes {
             // from and write to the main data bus via the following methods.
             Emulator() : cpu(*this) {}
 
-            // Load a simple program into RAM, useful for testing
-            void load_prog(const std::vector<uint8_t> &prog, uint16_t inst_nr);
+            // Load a simple program into RAM, useful for testing. Without a
+            // cartridge, the reset vector points to it
+            void load_prog(const std::vector<uint8_t> &prog);
 
-            // Start the emulator
-            void start();
+            // Load a cartridge from an iNES image in memory and reset the
+            // CPU, so that it starts executing the cartridge's program.
+            // Returns false if the image could not be loaded
+            bool load_rom(const uint8_t *image, size_t size);
+
+            // Same as above, but read the iNES image from a file first
+            bool load_rom_file(const std::string &path);
+
+            // Reset the console, as if by pressing its reset button. Memory
+            // is left as it is
+            void reset();
+
+            // Run the CPU for the rest of the current frame, without any
+            // output. Returns the number of instructions that were executed
+            uint64_t run_frame() { return run_until(frame_end); }
+
+            // Run the CPU until its cycle count reaches the given value, which
+            // may span any number of frames, or until a hook calls stop().
+            // Returns the number of instructions that were executed
+            uint64_t run_until(uint64_t cycle);
+
+            // Make the current run_frame or run_until call return as soon as
+            // the current instruction is done. Meant to be called from hooks;
+            // if called from an execution hook, the instruction the hook is
+            // on is not executed
+            void stop() { stop_requested = true; }
+
+            // Enable or disable idle loop skipping (on by default). It makes
+            // no observable difference, other than speed, so this is mostly
+            // useful for checking that it really doesn't
+            void set_idle_skipping(bool enabled) { idle_skipping = enabled; }
+
+            // Enable or disable the CPU's instruction fetch window (on by
+            // default; see processor.hpp). Same deal as idle loop skipping
+            void set_fetch_window(bool enabled) { cpu.set_fetch_window(enabled); }
+
+            // Enable or disable halt detection (off by default). A crashed
+            // program usually either runs into a JAM opcode, which locks the
+            // CPU up, or gets stuck in a loop that does no I/O, coming back
+            // to the very same state over and over. Either way, nothing is
+            // ever going to happen again, so a batch run may as well give up
+            // on it. This is checked at the end of every frame
+            void set_halt_detection(bool enabled);
+
+            // Whether the program was found to be halted and, if it was, the
+            // PC and frame it was found on. Cleared by a reset
+            bool is_halted() const { return halt.halted; }
+            uint16_t get_halt_pc() const { return halt.pc; }
+            uint64_t get_halt_frame() const { return halt.frame; }
+
+            // Register hooks (see hooks.hpp). Each returns an id that can be
+            // used to remove the hook later on
+            int add_frame_hook(FrameHook hook);
+            int add_exec_hook(uint16_t pc, ExecHook hook);
+            int add_write_hook(uint16_t addr, WriteHook hook);
+
+            // Remove a hook. Returns false if there is no hook with that id
+            bool remove_hook(int id);
+
+            // Get the number of frames run so far
+            uint64_t get_frame() const { return frame_nr; }
+
+            // Get the CPU cycle count at which the current frame ends
+            uint64_t get_frame_end() const { return frame_end; }
+
+            // Run a single CPU instruction, without any output. An execution
+            // hook may stop it from running, by calling stop()
+            void step() {
+                stop_requested = false;
+                if(hooks) step_impl<true>();
+                else step_impl<false>();
+            }
+
+            // Get a snapshot of the CPU registers
+            CpuState get_cpu_state() const { return cpu.get_state(); }
+
+            // Overwrite the CPU registers
+            void set_cpu_state(const CpuState &state) { cpu.set_state(state); }
+
+            // Get the values currently on the stack (see processor.hpp)
+            StackView get_stack() const { return cpu.get_stack(); }
+
+            // Set the state of the buttons of the controller plugged into the
+            // given port (0 or 1), one bit per button: A, B, Select, Start,
+            // Up, Down, Left and Right, from the least significant bit up
+            void set_input(unsigned port, uint8_t buttons) { input[port & 1] = buttons; }
+
+            // Set the input of both controllers for a number of frames in one
+            // go, starting with the current one. The schedule holds two bytes
+            // per frame, for ports 0 and 1, and is not copied: it has to
+            // outlive its use. Once it runs out, the last input is kept.
+            // Passing a null schedule cancels the current one
+            void set_input_schedule(const uint8_t *schedule, size_t frames);
+
+            // Direct access to RAM, for inspection and poking from the outside
+            std::array<uint8_t, 2048> &get_ram() { return ram; }
+            const std::array<uint8_t, 2048> &get_ram() const { return ram; }
+
+            // Direct access to the cartridge's program RAM
+            const std::array<uint8_t, 0x2000> &get_prg_ram() const { return cart.get_prg_ram(); }
+
+            // Run code from a module of natively compiled code (see
+            // recompiler.hpp) wherever it has any, and the interpreter
+            // everywhere else. The module has to be compiled from the
+            // current ROM, and is dropped once another one is loaded. Pages
+            // patched by cheats are left to the interpreter. Returns false if
+            // it can't be loaded
+            bool load_native(const std::string &path);
+
+            // Recompile code on the fly as it gets hot (see tiering.hpp), with
+            // the given compiler command and directory holding aot_abi.h, and
+            // keeping what it can in the given cache directory, if any (see
+            // code_cache.hpp). Like native code, this is dropped once another
+            // ROM is loaded. Returns false if it can't be set up
+            bool enable_tiering(const std::string &compiler, const std::string &include_dir,
+                    const std::string &cache_dir = "");
+
+            // Hash the program ROM, as it is in the image
+            uint64_t hash_prg_rom() const;
+
+            // Whether any of program ROM is patched by cheats
+            bool is_rom_patched() const { return cart.is_patched(); }
+
+            // Add a cheat code (see cheats.hpp). ROM patches take effect right
+            // away, while RAM freezes are applied at the end of every frame.
+            // Cheats survive resets, but not loading another ROM. Returns
+            // false if the code is malformed or does not apply to this ROM
+            bool add_cheat(const std::string &code);
+
+            // Remove all cheats
+            void clear_cheats();
+
+            // Export RAM through a POSIX shared memory segment with the given
+            // name, updated at the end of every frame (see SharedExport).
+            // Returns false if the segment could not be created
+            bool export_shared(const std::string &name);
+
+            // Stream the picture, a frame at the end of every frame, as
+            // YUV4MPEG2 video to the given file or pipe ("-" for stdout; see
+            // recorder.hpp). Until there is a PPU, every frame is all the
+            // backdrop color. If the consumer falls behind, emulation waits
+            // for it rather than losing frames. Returns false if the file
+            // could not be opened
+            bool record_video(const std::string &path);
+
+            // Likewise for the sound, as WAV at the given sample rate. Until
+            // there is an APU, it is silence, as long as the frames are
+            bool record_audio(const std::string &path, uint32_t sample_rate = 44100);
+
+            // Stop recording, once whatever is still queued is written out
+            void stop_recording();
+
+            // Size of a save state, in bytes
+            static const size_t state_size;
+
+            // Save the state of the console into a buffer of state_size bytes.
+            // The cartridge's ROM is not included: the state may only be
+            // loaded back into an emulator that has the same ROM loaded
+            void save_state(uint8_t *buffer) const;
+
+            // Load a state saved by the method above. Returns false if the
+            // buffer does not contain a valid save state
+            bool load_state(const uint8_t *buffer);
+
+            // Hash the contents of RAM, including the cartridge's program
+            // RAM, for comparison against known good runs
+            uint64_t hash_ram() const;
 
             // Read from the main data bus
             uint8_t read(uint16_t addr) const;
 
+            // Same as above, but without any side effects (the controllers'
+            // shift registers stay put), for debuggers and disassemblers
+            uint8_t peek(uint16_t addr) const;
+
+            // The counterpart of peek: write to RAM or the cartridge's
+            // program RAM without firing write hooks or counting as a write
+            // the program made. Anything else (I/O registers, ROM) is left
+            // alone. Code compiled from what changed is dropped all the same
+            void poke(uint16_t addr, uint8_t data);
+
+            // A number that changes whenever the contents of the 4KiB bank
+            // holding the given address may have, so that tools can tell that
+            // what they decoded from it is stale without looking at it all
+            // over again (see disassembler.hpp). Writes made straight to
+            // get_ram() are not noticed
+            uint64_t get_bank_version(uint16_t addr) const {
+                return bank_versions[addr >> 12] + (addr < 0x2000 ? ram_writes : 0);
+            }
+
+            // The 256 byte page of memory holding the given address, if
+            // reading from it is the same as calling read(). Pages with I/O
+            // registers or nothing behind them don't qualify. Valid until the
+            // memory map changes, which the CPU is told about
+            const uint8_t *code_page(uint16_t addr) const;
+
             // Write to the main data bus
             void write(uint16_t addr, uint8_t data);
 
@@ -53,16 +253,204 @@ namespace nes {
             // Starting address for the start of the program, hardcoded for now
             static const uint16_t prog_start = 0x0200;
 
-            // Size of the loaded program, temporary
-            uint16_t instruction_nr;
+            // Number of CPU cycles in a frame. Until there is a PPU to tell
+            // us when a frame ends, we use the (rounded up) NTSC figure
+            static const uint64_t cycles_per_frame = 29781;
+
+            // Number of frames run so far, and the CPU cycle count at which
+            // the current frame is due to end
+            uint64_t frame_nr = 0;
+            uint64_t frame_end = cycles_per_frame;
+
+            // Wrap up the current frame and move on to the next one
+            void end_frame() {
+                ++frame_nr;
+                frame_end += cycles_per_frame;
+                if(schedule) apply_schedule();
+                if(!freezes.empty()) apply_freezes();
+                if(native) native->quiescent();
+                if(tier) tier->poll();
+                if(shared) shared->publish(*this);
+                if(video || audio) record_frame();
+                if(hooks) {
+                    hooks->fire_frame(*this);
+                    release_hooks();
+                }
+                if(halt_detection) check_halt();
+            }
+
+            // Registered hooks, only allocated while there are any
+            std::unique_ptr<Hooks> hooks;
+
+            // Set by stop(), checked by the instrumented main loop
+            bool stop_requested = false;
+
+            // Get the registry, creating it if needed
+            Hooks &get_hooks();
+
+            // Drop the registry once the last hook is gone, so that the main
+            // loop goes back to its uninstrumented self. Not while hooks are
+            // being fired, though, as they are still using it
+            void release_hooks() {
+                if(hooks->empty() && !hooks->is_firing()) hooks.reset();
+            }
+
+            // The main loop comes in two flavors: with hooks and without them.
+            // Returns whether the instruction was actually executed
+            template<bool Hooked>
+            bool step_impl() {
+                if constexpr(Hooked) {
+                    uint16_t pc = cpu.get_pc();
+                    if(hooks->has_exec(pc)) {
+                        hooks->fire_exec(*this, pc);
+                        release_hooks();
+                        // Like a breakpoint, the hook may stop the
+                        // instruction from running at all
+                        if(stop_requested) return false;
+                    }
+                }
+                cpu.single_step();
+                if(cpu.get_cycles() >= frame_end) end_frame();
+                return true;
+            }
+
+            template<bool Hooked>
+            uint64_t run_loop(uint64_t cycle);
+
+            // Idle loop detection. Most games spend the rest of every frame
+            // spinning in a tiny loop, waiting for it to end. Loops are
+            // watched from the moment the PC jumps backwards: if, by the time
+            // it jumps back to the same place, nothing was written and no I/O
+            // register with side effects was read, and all registers are the
+            // same as they were, then every following iteration is bound to
+            // do exactly the same, until the frame ends. So we skip straight
+            // to that point, charging the cycles of the skipped iterations
+            bool idle_skipping = true;
+            struct IdleWatch {
+                bool active = false;
+                CpuState start;
+                uint64_t side_effects = 0;
+                uint64_t count = 0;
+            } idle;
+
+            // Number of writes and reads with side effects done so far
+            mutable uint64_t side_effects = 0;
+
+            // Called when the PC jumped backwards, count being the number of
+            // instructions run so far. Returns the number of skipped ones
+            uint64_t skip_idle(uint64_t cycle, uint64_t count);
+
+            // Halt detection (see set_halt_detection). The state at the end
+            // of a frame depends on where in the loop the frame happens to
+            // end, so a stuck loop may take any number of frames to come back
+            // to the same one. Brent's cycle detection finds it anyway: the
+            // hash of every frame's state is compared against a checkpoint,
+            // which moves up to the current frame after twice as many frames
+            // each time. It starts over whenever there was any I/O, which
+            // could change the course of the program
+            bool halt_detection = false;
+            struct HaltWatch {
+                bool halted = false;
+                uint16_t pc = 0;
+                uint64_t frame = 0;
+                uint64_t io_accesses = 0;
+                bool watching = false;
+                uint64_t checkpoint = 0;
+                uint64_t power = 1, length = 0;
+            } halt;
+
+            // Number of controller reads and strobe writes done so far
+            mutable uint64_t io_accesses = 0;
+
+            // Check whether the program is halted, at the end of a frame
+            void check_halt();
+
+            // Input schedule, if one was given, and the frame it starts on
+            const uint8_t *schedule = nullptr;
+            size_t schedule_frames = 0;
+            uint64_t schedule_start = 0;
+
+            // Take the current frame's input from the schedule
+            void apply_schedule();
+
+            // Natively compiled code, if any was loaded, and the context it
+            // runs with, whose bus side never changes
+            std::unique_ptr<NativeModule> native;
+            nes_aot_context native_ctx {};
+
+            // The compiler behind tiered execution, if it was enabled
+            std::unique_ptr<TieredCompiler> tier;
+
+            // Set up the context for running native code
+            void init_native();
+
+            // Code in the given range of addresses changed, so any natively
+            // compiled code for it is no longer valid
+            void code_changed(uint16_t first, uint16_t last);
+
+            // Drop natively compiled code for every page of program ROM
+            // patched by cheats, as it was compiled from the ROM as it is in
+            // the image
+            void drop_patched_code();
+
+            // RAM freeze cheats, and the method writing them every frame
+            std::vector<Cheat> freezes;
+            void apply_freezes();
+
+            // Shared memory export, if it was asked for
+            std::unique_ptr<SharedExport> shared;
+
+            // Recorders, if they were asked for, the picture as the palette
+            // indices the PPU would output, the sound as samples (room for as
+            // many as a frame can have, allocated once), and the fraction of
+            // a sample left over from the last frame, in CPU cycles times the
+            // sample rate
+            std::unique_ptr<VideoRecorder> video;
+            std::unique_ptr<AudioRecorder> audio;
+            std::vector<uint8_t> picture;
+            std::vector<int16_t> sound;
+            uint32_t sample_rate = 0;
+            uint64_t sample_phase = 0;
+
+            // The NTSC CPU clock, of which a frame lasts cycles_per_frame
+            static const uint64_t cpu_rate = 1789773;
+
+            // Hand the frame that just ended to the recorders
+            void record_frame();
+
+            // The game cartridge currently plugged into the console
+            Cartridge cart;
 
             // The 6502-like processor used by the NES
             Processor cpu;
 
+            // State of the buttons of both controllers
+            std::array<uint8_t, 2> input {};
+
+            // The controllers' shift registers. While the strobe bit written
+            // to $4016 is set, they keep getting reloaded with the state of
+            // the buttons; once it is cleared, each read from $4016 or $4017
+            // shifts the next button out of the corresponding register.
+            // Reading has side effects, which is why these are mutable
+            mutable std::array<uint8_t, 2> shift_reg {};
+            bool strobe = false;
+
             // 2KiB of RAM (riches beyond wonders!). Its address space spans,
             // however, a total of 8KiB, which is achieved through mirroring.
             // That is implemented in the read and write methods.
-            std::array<uint8_t, 2048> ram;
+            std::array<uint8_t, 2048> ram {};
+
+            // Number of writes to RAM so far, native code's included. Unlike
+            // side_effects, I/O and program RAM don't count
+            uint64_t ram_writes = 0;
+
+            // Changes to each 4KiB bank that ram_writes doesn't count (see
+            // get_bank_version), and the method for when any may have changed
+            std::array<uint64_t, 16> bank_versions {};
+            void touch_banks() {
+                for(uint64_t &version : bank_versions)
+                    ++version;
+            }
     };
 }
 
@@ -0,0 +1,86 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_GDB_STUB_HPP
+#define NES_GDB_STUB_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// A stub for GDB's remote serial protocol, listening on a loopback TCP port,
+// so that a debugger can inspect and control a running emulator. It supports
+// reading and writing registers and memory, breakpoints, write watchpoints,
+// single stepping and continuing, which runs at full speed until something
+// is hit (or the debugger interrupts it).
+//
+// GDB has no 6502 target of its own, so the register layout is ours: A, X,
+// Y, P and S as one byte each, followed by PC as two bytes, little endian.
+
+namespace nes {
+    class Emulator;
+
+    class GdbStub {
+        public:
+            GdbStub(Emulator &nes_emu) : nes_emu(nes_emu) {}
+
+            // Wait for a debugger to connect on the given port of the
+            // loopback interface, and serve it until it detaches or kills
+            // us. Returns false if the connection could not be established
+            bool serve(uint16_t port);
+
+        private:
+            Emulator &nes_emu;
+
+            // Socket of the current connection
+            int conn = -1;
+
+            // Largest packet we take, as told to the debugger. Memory reads
+            // are capped so that their replies fit in it too
+            static const size_t packet_size = 0x4000;
+
+            // Hook ids of the breakpoints and watchpoints, by address
+            std::map<uint16_t, int> breakpoints, watchpoints;
+
+            // Address of the watchpoint that stopped the last run, if any
+            int hit_watchpoint = -1;
+
+            // Receive a packet, acknowledging it, or asking for it again if
+            // its checksum is wrong. Returns false once the connection is gone
+            bool receive(std::string &packet);
+
+            // Send a packet, with its checksum
+            void send(const std::string &packet);
+
+            // Handle a single packet. Returns false if the session is over
+            bool handle(const std::string &packet);
+
+            // Run until a breakpoint or watchpoint is hit, or the debugger
+            // interrupts us, and return the stop reply
+            std::string resume();
+
+            // Execute a single instruction, stepping over any breakpoint on it
+            void single_step();
+
+            std::string read_registers() const;
+            bool write_registers(const std::string &hex);
+            std::string read_memory(uint16_t addr, size_t len) const;
+    };
+}
+
+#endif // NES_GDB_STUB_HPP
@@ -0,0 +1,36 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_HASH_HPP
+#define NES_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// A fast, non-cryptographic 64-bit hash (the xxHash64 algorithm), used to
+// compare emulator state against known good runs without keeping the state
+// itself around.
+
+namespace nes {
+    // Hash a block of memory. Passing the hash of one block as the seed for
+    // the next makes the result depend on both, but it is not the same as
+    // hashing them as a single block
+    uint64_t hash_bytes(const uint8_t *data, size_t size, uint64_t seed = 0);
+}
+
+#endif // NES_HASH_HPP
@@ -0,0 +1,109 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_HOOKS_HPP
+#define NES_HOOKS_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Hooks let tools observe the console without touching its main loop: they
+// are called at the end of every frame, before the instruction at a given
+// address is executed, or after a given address is written to. The emulator
+// only allocates a registry once the first hook is added, and only runs the
+// instrumented version of its main loop while there is one, so that hooks
+// cost nothing at all when they are not in use.
+
+namespace nes {
+    class Emulator;
+
+    using FrameHook = std::function<void(Emulator &nes_emu)>;
+    using ExecHook = std::function<void(Emulator &nes_emu, uint16_t pc)>;
+    using WriteHook = std::function<void(Emulator &nes_emu, uint16_t addr, uint8_t data)>;
+
+    // Registry of hooks, owned by the emulator. Hooks may add and remove
+    // hooks, themselves included, while they are being fired: removed ones
+    // are only marked as such until the outermost fire_* call is done, and
+    // added ones wait for the next time around
+    class Hooks {
+        public:
+            int add_frame(FrameHook hook);
+            int add_exec(uint16_t pc, ExecHook hook);
+            int add_write(uint16_t addr, WriteHook hook);
+
+            // Remove the hook with the given id, of whatever kind it is.
+            // Returns false if there is no such hook
+            bool remove(int id);
+
+            // Whether there are no hooks left at all
+            bool empty() const { return live == 0; }
+
+            // Whether any hooks are being fired right now, in which case
+            // the registry must stay around even if it is empty
+            bool is_firing() const { return firing > 0; }
+
+            // Whether there are any hooks on the given address, which is all
+            // the main loop has to check in the common case
+            bool has_exec(uint16_t pc) const { return exec_map[pc]; }
+            bool has_write(uint16_t addr) const { return write_map[addr]; }
+
+            void fire_frame(Emulator &nes_emu);
+            void fire_exec(Emulator &nes_emu, uint16_t pc);
+            void fire_write(Emulator &nes_emu, uint16_t addr, uint8_t data);
+
+        private:
+            template<typename Hook>
+            struct Entry {
+                int id;
+                uint16_t addr;
+                Hook hook;
+                bool removed = false;
+            };
+
+            // Deques, because adding to them leaves the hook being run where
+            // it is
+            int next_id = 0;
+            std::deque<Entry<FrameHook>> frame_hooks;
+            std::deque<Entry<ExecHook>> exec_hooks;
+            std::deque<Entry<WriteHook>> write_hooks;
+
+            // Number of hooks not removed, nesting depth of fire_* calls and
+            // whether any hooks were removed during them
+            size_t live = 0;
+            int firing = 0;
+            bool swept = true;
+
+            // Marks the registry as firing for as long as it is around, and
+            // erases removed hooks once the outermost call is done
+            struct Firing {
+                Hooks &hooks;
+                Firing(Hooks &hooks) : hooks(hooks) { ++hooks.firing; }
+                ~Firing() { if(--hooks.firing == 0 && !hooks.swept) hooks.sweep(); }
+            };
+
+            // Erase the hooks marked as removed
+            void sweep();
+
+            // One bit per address, set when there is a hook on it
+            std::bitset<0x10000> exec_map, write_map;
+    };
+}
+
+#endif // NES_HOOKS_HPP
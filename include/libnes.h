@@ -0,0 +1,159 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_LIBNES_H
+#define NES_LIBNES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* C interface to the emulator, for embedding it in programs that are not
+   written in C++ (or that do not want to depend on its C++ API). Emulators
+   are opaque handles. None of the functions meant to be called once per
+   frame allocate or copy anything: memory is exposed through pointers that
+   stay valid until the emulator is destroyed. No C++ exception ever gets
+   through: functions that can fail (on running out of memory, say) report
+   it through their return value. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a change breaks the ABI */
+#define NES_ABI_VERSION 1
+
+typedef struct nes_emulator nes_emulator;
+
+/* Get the ABI version the library was built with */
+int nes_abi_version(void);
+
+/* Create an emulator, with no cartridge. Returns NULL on failure */
+nes_emulator *nes_create(void);
+
+/* Destroy an emulator created by nes_create */
+void nes_destroy(nes_emulator *emu);
+
+/* Load a cartridge from an iNES image in memory and reset the console. The
+   image is copied, so it need not outlive the call. Returns 0 on success */
+int nes_load_rom(nes_emulator *emu, const uint8_t *image, size_t size);
+
+/* Reset the console, as if by pressing its reset button */
+void nes_reset(nes_emulator *emu);
+
+/* Run the console for a frame. Returns the number of instructions executed,
+   or 0 if the frame could not be run */
+uint64_t nes_run_frame(nes_emulator *emu);
+
+/* Set the state of the buttons of the controller in the given port (0 or 1),
+   one bit per button: A, B, Select, Start, Up, Down, Left, Right, from the
+   least significant bit up */
+void nes_set_input(nes_emulator *emu, unsigned port, uint8_t buttons);
+
+/* Set the input of both controllers for a number of frames, starting with the
+   current one, two bytes per frame (ports 0 and 1). The schedule is not
+   copied, so it has to stay valid while it is in use. Once it runs out, the
+   last input is kept. Passing NULL cancels the current schedule */
+void nes_set_input_schedule(nes_emulator *emu, const uint8_t *schedule,
+        size_t frames);
+
+/* Get a pointer to the framebuffer, 256x240 palette indices. There is no PPU
+   yet, so this always returns NULL for now */
+const uint8_t *nes_framebuffer(const nes_emulator *emu);
+
+/* Get a pointer to the 2KiB of RAM, which may be written to */
+uint8_t *nes_ram(nes_emulator *emu);
+
+/* Registers of the CPU, and the number of cycles it ran since the last reset */
+typedef struct nes_cpu_state {
+    uint16_t pc;
+    uint8_t a, x, y, sp, p;
+    uint64_t cycles;
+} nes_cpu_state;
+
+/* Get the state of the CPU */
+void nes_get_cpu_state(const nes_emulator *emu, nes_cpu_state *state);
+
+/* Overwrite the state of the CPU */
+void nes_set_cpu_state(nes_emulator *emu, const nes_cpu_state *state);
+
+/* Get the values currently on the stack, from top to bottom, storing how many
+   there are in size. The pointer is only valid until the emulator runs again */
+const uint8_t *nes_stack(const nes_emulator *emu, size_t *size);
+
+/* Add a cheat code: Game Genie, or raw AAAA:VV to patch ROM or freeze RAM.
+   Returns 0 on success */
+int nes_add_cheat(nes_emulator *emu, const char *code);
+
+/* Remove all cheats */
+void nes_clear_cheats(nes_emulator *emu);
+
+/* Export RAM through a POSIX shared memory segment with the given name,
+   which has to start with a slash. It is updated at the end of every frame;
+   see shared_export.hpp for its layout. Returns 0 on success */
+int nes_export_shared(nes_emulator *emu, const char *name);
+
+/* Stream the picture as YUV4MPEG2 video, or the sound as WAV at the given
+   sample rate, to a file or pipe ("-" for stdout), from the end of the
+   current frame on. There is no PPU or APU yet, so these are a blank picture
+   and silence for now. Emulation waits for a consumer that falls behind.
+   Returns 0 on success */
+int nes_record_video(nes_emulator *emu, const char *path);
+int nes_record_audio(nes_emulator *emu, const char *path, uint32_t sample_rate);
+
+/* Stop recording, once whatever is still queued is written out */
+void nes_stop_recording(nes_emulator *emu);
+
+/* Hooks, called at the end of every frame, before the instruction at a given
+   address is executed, or after a given address is written to. They cost
+   nothing while none are registered. Each add function returns an id for
+   nes_remove_hook, or -1 on failure. Hooks may add and remove hooks,
+   themselves included; added ones are first called the next time around */
+typedef void (*nes_frame_hook)(nes_emulator *emu, void *user);
+typedef void (*nes_exec_hook)(nes_emulator *emu, void *user, uint16_t pc);
+typedef void (*nes_write_hook)(nes_emulator *emu, void *user, uint16_t addr,
+        uint8_t data);
+
+int nes_add_frame_hook(nes_emulator *emu, nes_frame_hook hook, void *user);
+int nes_add_exec_hook(nes_emulator *emu, uint16_t pc, nes_exec_hook hook,
+        void *user);
+int nes_add_write_hook(nes_emulator *emu, uint16_t addr, nes_write_hook hook,
+        void *user);
+
+/* Remove a hook. Returns 0 on success */
+int nes_remove_hook(nes_emulator *emu, int id);
+
+/* Make nes_run_frame return as soon as the current instruction is done. Meant
+   to be called from hooks */
+void nes_stop(nes_emulator *emu);
+
+/* Size of the buffers used by nes_save_state and nes_load_state */
+size_t nes_state_size(void);
+
+/* Save the state of the console into a buffer of nes_state_size() bytes.
+   Returns 0 on success */
+int nes_save_state(const nes_emulator *emu, uint8_t *buffer, size_t size);
+
+/* Load a state saved by nes_save_state, with the same ROM loaded. Returns 0
+   on success */
+int nes_load_state(nes_emulator *emu, const uint8_t *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NES_LIBNES_H */
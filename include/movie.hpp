@@ -0,0 +1,36 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_MOVIE_HPP
+#define NES_MOVIE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reading of input movies, which record the state of the controllers on each
+// frame of a run, so that it can be replayed exactly.
+
+namespace nes {
+    // Read the input log of an FCEUX movie (.fm2) into an input schedule, as
+    // taken by Emulator::set_input_schedule. Returns false if the file could
+    // not be read
+    bool read_fm2(const std::string &path, std::vector<uint8_t> &schedule);
+}
+
+#endif // NES_MOVIE_HPP
@@ -0,0 +1,106 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_NATIVE_MODULE_HPP
+#define NES_NATIVE_MODULE_HPP
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "aot_abi.h"
+#include "shared_code.hpp"
+
+// Natively compiled code, as produced by the recompiler, loaded with dlopen.
+// Any number of modules can be loaded, whether they were compiled ahead of
+// time or on the fly (see tiering.hpp). Their blocks are mapped by address,
+// from $6000 up; code without a block is left to the interpreter. Program ROM
+// code may also come from other instances running the same ROM (see
+// shared_code.hpp), for addresses without a block of our own.
+
+namespace nes {
+    class NativeModule {
+        public:
+            NativeModule() = default;
+            ~NativeModule();
+
+            NativeModule(const NativeModule&) = delete;
+            NativeModule &operator=(const NativeModule&) = delete;
+
+            // Load a module, which must have been compiled from a program ROM
+            // with the given hash. Its blocks replace any previously loaded
+            // ones at the same addresses. Returns false if it can't be used
+            bool load(const std::string &path, uint64_t rom_hash);
+
+            // Get the block starting at the given address, if there is one
+            const nes_aot_block_info *find(uint16_t addr) const {
+                if(addr < base) return nullptr;
+                if(const nes_aot_block_info *block = table[addr - base]) return block;
+                if(!shared || addr < 0x8000 || shadowed[addr - 0x8000]) return nullptr;
+                return shared->find(addr);
+            }
+
+            // Run shared program ROM code too
+            void share(std::shared_ptr<SharedCode> code);
+
+            // The shared code being run, if any
+            SharedCode *shared_code() const { return shared.get(); }
+
+            // No block is running right now, nor will be until the next call
+            // to find(). Shared code may be unloaded while this holds
+            void quiescent() {
+                if(shared) shared->quiescent(reader);
+            }
+
+            // Program ROM is as it was in the image again, so shared code
+            // invalidated before can be run again
+            void unshadow() { shadowed.reset(); }
+
+            // Whether any block was compiled from code in program RAM at the
+            // given address, which means writes there have to invalidate it
+            bool covers(uint16_t addr) const {
+                return addr >= base && addr < 0x8000 && ram_code[addr - base];
+            }
+
+            // Drop every block with code in the given range of addresses,
+            // which has changed since it was compiled. Shared blocks are only
+            // dropped for this instance. Returns the addresses of the blocks
+            // that were dropped
+            std::vector<uint16_t> invalidate(uint16_t first, uint16_t last);
+
+        private:
+            std::vector<void*> handles;
+
+            // Blocks by address, from program RAM up
+            static const uint16_t base = 0x6000;
+            std::array<const nes_aot_block_info*, 0x10000 - base> table {};
+
+            // Program RAM holding code that was compiled
+            std::bitset<0x8000 - base> ram_code;
+
+            // Shared program ROM code, and the shared blocks we can't run as
+            // the code in our ROM changed
+            std::shared_ptr<SharedCode> shared;
+            SharedCode::Reader reader;
+            std::bitset<0x8000> shadowed;
+    };
+}
+
+#endif // NES_NATIVE_MODULE_HPP
@@ -0,0 +1,339 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_OPCODES_HPP
+#define NES_OPCODES_HPP
+
+#include <cstdint>
+
+// Static information about each of the 256 opcodes of the 6502, illegal ones
+// included: which instruction it is, its addressing mode and how long it
+// takes. The interpreter, the disassembler and friends all share this table.
+
+namespace nes {
+    // Addressing modes are basically the different "flavors" the same
+    // instruction may come in. They specify how many additional bytes
+    // will be needed beyond the opcode and in which way those bytes,
+    // if present, will be used by the instruction. They can be
+    // uniquely determined from the opcode.
+    enum class Addressing : uint8_t {
+        Null        , // initial, invalid addressing mode
+        Implied     ,
+        Accumulator ,
+        Immediate   ,
+        ZeroPage    ,
+        ZeroPage_x  ,
+        ZeroPage_y  ,
+        Relative    ,
+        Absolute    ,
+        Absolute_x  ,
+        Absolute_y  ,
+        Indirect    ,
+        Indirect_x  ,
+        Indirect_y  ,
+    };
+
+    // Number of operand bytes that follow the opcode in each addressing mode
+    constexpr uint8_t operand_size(Addressing mode) {
+        switch(mode) {
+            case Addressing::Null:
+            case Addressing::Implied:
+            case Addressing::Accumulator:
+                return 0;
+            case Addressing::Absolute:
+            case Addressing::Absolute_x:
+            case Addressing::Absolute_y:
+            case Addressing::Indirect:
+                return 2;
+            default:
+                return 1;
+        }
+    }
+
+    struct OpcodeInfo {
+        const char *mnemonic;
+        Addressing mode;
+        // Base number of clock cycles, not counting the extra cycles for
+        // crossed page boundaries and taken branches (JAMs are listed as 2)
+        uint8_t cycles;
+        // Whether the opcode is part of the documented instruction set
+        bool official;
+    };
+
+    // Indexed by opcode. Being constexpr, it costs nothing at startup
+    inline constexpr OpcodeInfo opcode_table[256] = {
+        { "BRK", Addressing::Implied,     7, true  }, // 00
+        { "ORA", Addressing::Indirect_x,  6, true  }, // 01
+        { "JAM", Addressing::Implied,     2, false }, // 02
+        { "SLO", Addressing::Indirect_x,  8, false }, // 03
+        { "NOP", Addressing::ZeroPage,    3, false }, // 04
+        { "ORA", Addressing::ZeroPage,    3, true  }, // 05
+        { "ASL", Addressing::ZeroPage,    5, true  }, // 06
+        { "SLO", Addressing::ZeroPage,    5, false }, // 07
+        { "PHP", Addressing::Implied,     3, true  }, // 08
+        { "ORA", Addressing::Immediate,   2, true  }, // 09
+        { "ASL", Addressing::Accumulator, 2, true  }, // 0A
+        { "ANC", Addressing::Immediate,   2, false }, // 0B
+        { "NOP", Addressing::Absolute,    4, false }, // 0C
+        { "ORA", Addressing::Absolute,    4, true  }, // 0D
+        { "ASL", Addressing::Absolute,    6, true  }, // 0E
+        { "SLO", Addressing::Absolute,    6, false }, // 0F
+        { "BPL", Addressing::Relative,    2, true  }, // 10
+        { "ORA", Addressing::Indirect_y,  5, true  }, // 11
+        { "JAM", Addressing::Implied,     2, false }, // 12
+        { "SLO", Addressing::Indirect_y,  8, false }, // 13
+        { "NOP", Addressing::ZeroPage_x,  4, false }, // 14
+        { "ORA", Addressing::ZeroPage_x,  4, true  }, // 15
+        { "ASL", Addressing::ZeroPage_x,  6, true  }, // 16
+        { "SLO", Addressing::ZeroPage_x,  6, false }, // 17
+        { "CLC", Addressing::Implied,     2, true  }, // 18
+        { "ORA", Addressing::Absolute_y,  4, true  }, // 19
+        { "NOP", Addressing::Implied,     2, false }, // 1A
+        { "SLO", Addressing::Absolute_y,  7, false }, // 1B
+        { "NOP", Addressing::Absolute_x,  4, false }, // 1C
+        { "ORA", Addressing::Absolute_x,  4, true  }, // 1D
+        { "ASL", Addressing::Absolute_x,  7, true  }, // 1E
+        { "SLO", Addressing::Absolute_x,  7, false }, // 1F
+        { "JSR", Addressing::Absolute,    6, true  }, // 20
+        { "AND", Addressing::Indirect_x,  6, true  }, // 21
+        { "JAM", Addressing::Implied,     2, false }, // 22
+        { "RLA", Addressing::Indirect_x,  8, false }, // 23
+        { "BIT", Addressing::ZeroPage,    3, true  }, // 24
+        { "AND", Addressing::ZeroPage,    3, true  }, // 25
+        { "ROL", Addressing::ZeroPage,    5, true  }, // 26
+        { "RLA", Addressing::ZeroPage,    5, false }, // 27
+        { "PLP", Addressing::Implied,     4, true  }, // 28
+        { "AND", Addressing::Immediate,   2, true  }, // 29
+        { "ROL", Addressing::Accumulator, 2, true  }, // 2A
+        { "ANC", Addressing::Immediate,   2, false }, // 2B
+        { "BIT", Addressing::Absolute,    4, true  }, // 2C
+        { "AND", Addressing::Absolute,    4, true  }, // 2D
+        { "ROL", Addressing::Absolute,    6, true  }, // 2E
+        { "RLA", Addressing::Absolute,    6, false }, // 2F
+        { "BMI", Addressing::Relative,    2, true  }, // 30
+        { "AND", Addressing::Indirect_y,  5, true  }, // 31
+        { "JAM", Addressing::Implied,     2, false }, // 32
+        { "RLA", Addressing::Indirect_y,  8, false }, // 33
+        { "NOP", Addressing::ZeroPage_x,  4, false }, // 34
+        { "AND", Addressing::ZeroPage_x,  4, true  }, // 35
+        { "ROL", Addressing::ZeroPage_x,  6, true  }, // 36
+        { "RLA", Addressing::ZeroPage_x,  6, false }, // 37
+        { "SEC", Addressing::Implied,     2, true  }, // 38
+        { "AND", Addressing::Absolute_y,  4, true  }, // 39
+        { "NOP", Addressing::Implied,     2, false }, // 3A
+        { "RLA", Addressing::Absolute_y,  7, false }, // 3B
+        { "NOP", Addressing::Absolute_x,  4, false }, // 3C
+        { "AND", Addressing::Absolute_x,  4, true  }, // 3D
+        { "ROL", Addressing::Absolute_x,  7, true  }, // 3E
+        { "RLA", Addressing::Absolute_x,  7, false }, // 3F
+        { "RTI", Addressing::Implied,     6, true  }, // 40
+        { "EOR", Addressing::Indirect_x,  6, true  }, // 41
+        { "JAM", Addressing::Implied,     2, false }, // 42
+        { "SRE", Addressing::Indirect_x,  8, false }, // 43
+        { "NOP", Addressing::ZeroPage,    3, false }, // 44
+        { "EOR", Addressing::ZeroPage,    3, true  }, // 45
+        { "LSR", Addressing::ZeroPage,    5, true  }, // 46
+        { "SRE", Addressing::ZeroPage,    5, false }, // 47
+        { "PHA", Addressing::Implied,     3, true  }, // 48
+        { "EOR", Addressing::Immediate,   2, true  }, // 49
+        { "LSR", Addressing::Accumulator, 2, true  }, // 4A
+        { "ALR", Addressing::Immediate,   2, false }, // 4B
+        { "JMP", Addressing::Absolute,    3, true  }, // 4C
+        { "EOR", Addressing::Absolute,    4, true  }, // 4D
+        { "LSR", Addressing::Absolute,    6, true  }, // 4E
+        { "SRE", Addressing::Absolute,    6, false }, // 4F
+        { "BVC", Addressing::Relative,    2, true  }, // 50
+        { "EOR", Addressing::Indirect_y,  5, true  }, // 51
+        { "JAM", Addressing::Implied,     2, false }, // 52
+        { "SRE", Addressing::Indirect_y,  8, false }, // 53
+        { "NOP", Addressing::ZeroPage_x,  4, false }, // 54
+        { "EOR", Addressing::ZeroPage_x,  4, true  }, // 55
+        { "LSR", Addressing::ZeroPage_x,  6, true  }, // 56
+        { "SRE", Addressing::ZeroPage_x,  6, false }, // 57
+        { "CLI", Addressing::Implied,     2, true  }, // 58
+        { "EOR", Addressing::Absolute_y,  4, true  }, // 59
+        { "NOP", Addressing::Implied,     2, false }, // 5A
+        { "SRE", Addressing::Absolute_y,  7, false }, // 5B
+        { "NOP", Addressing::Absolute_x,  4, false }, // 5C
+        { "EOR", Addressing::Absolute_x,  4, true  }, // 5D
+        { "LSR", Addressing::Absolute_x,  7, true  }, // 5E
+        { "SRE", Addressing::Absolute_x,  7, false }, // 5F
+        { "RTS", Addressing::Implied,     6, true  }, // 60
+        { "ADC", Addressing::Indirect_x,  6, true  }, // 61
+        { "JAM", Addressing::Implied,     2, false }, // 62
+        { "RRA", Addressing::Indirect_x,  8, false }, // 63
+        { "NOP", Addressing::ZeroPage,    3, false }, // 64
+        { "ADC", Addressing::ZeroPage,    3, true  }, // 65
+        { "ROR", Addressing::ZeroPage,    5, true  }, // 66
+        { "RRA", Addressing::ZeroPage,    5, false }, // 67
+        { "PLA", Addressing::Implied,     4, true  }, // 68
+        { "ADC", Addressing::Immediate,   2, true  }, // 69
+        { "ROR", Addressing::Accumulator, 2, true  }, // 6A
+        { "ARR", Addressing::Immediate,   2, false }, // 6B
+        { "JMP", Addressing::Indirect,    5, true  }, // 6C
+        { "ADC", Addressing::Absolute,    4, true  }, // 6D
+        { "ROR", Addressing::Absolute,    6, true  }, // 6E
+        { "RRA", Addressing::Absolute,    6, false }, // 6F
+        { "BVS", Addressing::Relative,    2, true  }, // 70
+        { "ADC", Addressing::Indirect_y,  5, true  }, // 71
+        { "JAM", Addressing::Implied,     2, false }, // 72
+        { "RRA", Addressing::Indirect_y,  8, false }, // 73
+        { "NOP", Addressing::ZeroPage_x,  4, false }, // 74
+        { "ADC", Addressing::ZeroPage_x,  4, true  }, // 75
+        { "ROR", Addressing::ZeroPage_x,  6, true  }, // 76
+        { "RRA", Addressing::ZeroPage_x,  6, false }, // 77
+        { "SEI", Addressing::Implied,     2, true  }, // 78
+        { "ADC", Addressing::Absolute_y,  4, true  }, // 79
+        { "NOP", Addressing::Implied,     2, false }, // 7A
+        { "RRA", Addressing::Absolute_y,  7, false }, // 7B
+        { "NOP", Addressing::Absolute_x,  4, false }, // 7C
+        { "ADC", Addressing::Absolute_x,  4, true  }, // 7D
+        { "ROR", Addressing::Absolute_x,  7, true  }, // 7E
+        { "RRA", Addressing::Absolute_x,  7, false }, // 7F
+        { "NOP", Addressing::Immediate,   2, false }, // 80
+        { "STA", Addressing::Indirect_x,  6, true  }, // 81
+        { "NOP", Addressing::Immediate,   2, false }, // 82
+        { "SAX", Addressing::Indirect_x,  6, false }, // 83
+        { "STY", Addressing::ZeroPage,    3, true  }, // 84
+        { "STA", Addressing::ZeroPage,    3, true  }, // 85
+        { "STX", Addressing::ZeroPage,    3, true  }, // 86
+        { "SAX", Addressing::ZeroPage,    3, false }, // 87
+        { "DEY", Addressing::Implied,     2, true  }, // 88
+        { "NOP", Addressing::Immediate,   2, false }, // 89
+        { "TXA", Addressing::Implied,     2, true  }, // 8A
+        { "XAA", Addressing::Immediate,   2, false }, // 8B
+        { "STY", Addressing::Absolute,    4, true  }, // 8C
+        { "STA", Addressing::Absolute,    4, true  }, // 8D
+        { "STX", Addressing::Absolute,    4, true  }, // 8E
+        { "SAX", Addressing::Absolute,    4, false }, // 8F
+        { "BCC", Addressing::Relative,    2, true  }, // 90
+        { "STA", Addressing::Indirect_y,  6, true  }, // 91
+        { "JAM", Addressing::Implied,     2, false }, // 92
+        { "AHX", Addressing::Indirect_y,  6, false }, // 93
+        { "STY", Addressing::ZeroPage_x,  4, true  }, // 94
+        { "STA", Addressing::ZeroPage_x,  4, true  }, // 95
+        { "STX", Addressing::ZeroPage_y,  4, true  }, // 96
+        { "SAX", Addressing::ZeroPage_y,  4, false }, // 97
+        { "TYA", Addressing::Implied,     2, true  }, // 98
+        { "STA", Addressing::Absolute_y,  5, true  }, // 99
+        { "TXS", Addressing::Implied,     2, true  }, // 9A
+        { "TAS", Addressing::Absolute_y,  5, false }, // 9B
+        { "SHY", Addressing::Absolute_x,  5, false }, // 9C
+        { "STA", Addressing::Absolute_x,  5, true  }, // 9D
+        { "SHX", Addressing::Absolute_y,  5, false }, // 9E
+        { "AHX", Addressing::Absolute_y,  5, false }, // 9F
+        { "LDY", Addressing::Immediate,   2, true  }, // A0
+        { "LDA", Addressing::Indirect_x,  6, true  }, // A1
+        { "LDX", Addressing::Immediate,   2, true  }, // A2
+        { "LAX", Addressing::Indirect_x,  6, false }, // A3
+        { "LDY", Addressing::ZeroPage,    3, true  }, // A4
+        { "LDA", Addressing::ZeroPage,    3, true  }, // A5
+        { "LDX", Addressing::ZeroPage,    3, true  }, // A6
+        { "LAX", Addressing::ZeroPage,    3, false }, // A7
+        { "TAY", Addressing::Implied,     2, true  }, // A8
+        { "LDA", Addressing::Immediate,   2, true  }, // A9
+        { "TAX", Addressing::Implied,     2, true  }, // AA
+        { "LAX", Addressing::Immediate,   2, false }, // AB
+        { "LDY", Addressing::Absolute,    4, true  }, // AC
+        { "LDA", Addressing::Absolute,    4, true  }, // AD
+        { "LDX", Addressing::Absolute,    4, true  }, // AE
+        { "LAX", Addressing::Absolute,    4, false }, // AF
+        { "BCS", Addressing::Relative,    2, true  }, // B0
+        { "LDA", Addressing::Indirect_y,  5, true  }, // B1
+        { "JAM", Addressing::Implied,     2, false }, // B2
+        { "LAX", Addressing::Indirect_y,  5, false }, // B3
+        { "LDY", Addressing::ZeroPage_x,  4, true  }, // B4
+        { "LDA", Addressing::ZeroPage_x,  4, true  }, // B5
+        { "LDX", Addressing::ZeroPage_y,  4, true  }, // B6
+        { "LAX", Addressing::ZeroPage_y,  4, false }, // B7
+        { "CLV", Addressing::Implied,     2, true  }, // B8
+        { "LDA", Addressing::Absolute_y,  4, true  }, // B9
+        { "TSX", Addressing::Implied,     2, true  }, // BA
+        { "LAS", Addressing::Absolute_y,  4, false }, // BB
+        { "LDY", Addressing::Absolute_x,  4, true  }, // BC
+        { "LDA", Addressing::Absolute_x,  4, true  }, // BD
+        { "LDX", Addressing::Absolute_y,  4, true  }, // BE
+        { "LAX", Addressing::Absolute_y,  4, false }, // BF
+        { "CPY", Addressing::Immediate,   2, true  }, // C0
+        { "CMP", Addressing::Indirect_x,  6, true  }, // C1
+        { "NOP", Addressing::Immediate,   2, false }, // C2
+        { "DCP", Addressing::Indirect_x,  8, false }, // C3
+        { "CPY", Addressing::ZeroPage,    3, true  }, // C4
+        { "CMP", Addressing::ZeroPage,    3, true  }, // C5
+        { "DEC", Addressing::ZeroPage,    5, true  }, // C6
+        { "DCP", Addressing::ZeroPage,    5, false }, // C7
+        { "INY", Addressing::Implied,     2, true  }, // C8
+        { "CMP", Addressing::Immediate,   2, true  }, // C9
+        { "DEX", Addressing::Implied,     2, true  }, // CA
+        { "AXS", Addressing::Immediate,   2, false }, // CB
+        { "CPY", Addressing::Absolute,    4, true  }, // CC
+        { "CMP", Addressing::Absolute,    4, true  }, // CD
+        { "DEC", Addressing::Absolute,    6, true  }, // CE
+        { "DCP", Addressing::Absolute,    6, false }, // CF
+        { "BNE", Addressing::Relative,    2, true  }, // D0
+        { "CMP", Addressing::Indirect_y,  5, true  }, // D1
+        { "JAM", Addressing::Implied,     2, false }, // D2
+        { "DCP", Addressing::Indirect_y,  8, false }, // D3
+        { "NOP", Addressing::ZeroPage_x,  4, false }, // D4
+        { "CMP", Addressing::ZeroPage_x,  4, true  }, // D5
+        { "DEC", Addressing::ZeroPage_x,  6, true  }, // D6
+        { "DCP", Addressing::ZeroPage_x,  6, false }, // D7
+        { "CLD", Addressing::Implied,     2, true  }, // D8
+        { "CMP", Addressing::Absolute_y,  4, true  }, // D9
+        { "NOP", Addressing::Implied,     2, false }, // DA
+        { "DCP", Addressing::Absolute_y,  7, false }, // DB
+        { "NOP", Addressing::Absolute_x,  4, false }, // DC
+        { "CMP", Addressing::Absolute_x,  4, true  }, // DD
+        { "DEC", Addressing::Absolute_x,  7, true  }, // DE
+        { "DCP", Addressing::Absolute_x,  7, false }, // DF
+        { "CPX", Addressing::Immediate,   2, true  }, // E0
+        { "SBC", Addressing::Indirect_x,  6, true  }, // E1
+        { "NOP", Addressing::Immediate,   2, false }, // E2
+        { "ISC", Addressing::Indirect_x,  8, false }, // E3
+        { "CPX", Addressing::ZeroPage,    3, true  }, // E4
+        { "SBC", Addressing::ZeroPage,    3, true  }, // E5
+        { "INC", Addressing::ZeroPage,    5, true  }, // E6
+        { "ISC", Addressing::ZeroPage,    5, false }, // E7
+        { "INX", Addressing::Implied,     2, true  }, // E8
+        { "SBC", Addressing::Immediate,   2, true  }, // E9
+        { "NOP", Addressing::Implied,     2, true  }, // EA
+        { "SBC", Addressing::Immediate,   2, false }, // EB
+        { "CPX", Addressing::Absolute,    4, true  }, // EC
+        { "SBC", Addressing::Absolute,    4, true  }, // ED
+        { "INC", Addressing::Absolute,    6, true  }, // EE
+        { "ISC", Addressing::Absolute,    6, false }, // EF
+        { "BEQ", Addressing::Relative,    2, true  }, // F0
+        { "SBC", Addressing::Indirect_y,  5, true  }, // F1
+        { "JAM", Addressing::Implied,     2, false }, // F2
+        { "ISC", Addressing::Indirect_y,  8, false }, // F3
+        { "NOP", Addressing::ZeroPage_x,  4, false }, // F4
+        { "SBC", Addressing::ZeroPage_x,  4, true  }, // F5
+        { "INC", Addressing::ZeroPage_x,  6, true  }, // F6
+        { "ISC", Addressing::ZeroPage_x,  6, false }, // F7
+        { "SED", Addressing::Implied,     2, true  }, // F8
+        { "SBC", Addressing::Absolute_y,  4, true  }, // F9
+        { "NOP", Addressing::Implied,     2, false }, // FA
+        { "ISC", Addressing::Absolute_y,  7, false }, // FB
+        { "NOP", Addressing::Absolute_x,  4, false }, // FC
+        { "SBC", Addressing::Absolute_x,  4, true  }, // FD
+        { "INC", Addressing::Absolute_x,  7, true  }, // FE
+        { "ISC", Addressing::Absolute_x,  7, false }, // FF
+    };
+}
+
+#endif // NES_OPCODES_HPP
@@ -19,19 +19,92 @@
 #ifndef NES_PROCESSOR_HPP
 #define NES_PROCESSOR_HPP
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include "aot_abi.h"
+#include "opcodes.hpp"
 
 namespace nes { class Emulator; } // stupid forward declaration :)
 
+namespace nes {
+    // A snapshot of the processor's registers, which can be used to inspect
+    // or change its state from the outside
+    struct CpuState {
+        uint16_t pc = 0;
+        uint8_t acc = 0, x = 0, y = 0;
+        uint8_t stack_ptr = 0xFF;
+        uint8_t status = 0;
+        uint64_t cycles = 0;
+    };
+
+    // A read-only view of the values on the stack, from top to bottom. It
+    // points straight into RAM, so it is only valid until the next instruction
+    struct StackView {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+    };
+}
+
+// The 6502 came in a few variants, which differ in small but observable
+// ways. Each one is described by a policy class, which the processor takes
+// as a template parameter, so that whatever a variant lacks is compiled out
+// of it entirely rather than checked for at every instruction.
+
+namespace nes {
+    // The Ricoh 2A03 used by the NES: an NMOS 6502 with decimal mode cut out.
+    // The decimal flag can still be set and cleared, but it does nothing
+    struct Ricoh2A03 {
+        static constexpr bool decimal_mode = false;
+        static constexpr bool cmos = false;
+    };
+
+    // The original NMOS 6502, as found in most other 8-bit machines. Its
+    // decimal mode leaves the N, V and Z flags in a weird state
+    struct Nmos6502 {
+        static constexpr bool decimal_mode = true;
+        static constexpr bool cmos = false;
+    };
+
+    // The CMOS 65C02, which fixed the indirect jump bug and made the flags
+    // valid in decimal mode, at the cost of one extra cycle
+    struct Wdc65C02 {
+        static constexpr bool decimal_mode = true;
+        static constexpr bool cmos = true;
+    };
+}
+
+// The processor is also generic over the bus it is connected to, which has to
+// provide read and write methods, plus code_page, which gives the 256 byte
+// page holding an address if it is plain memory that can be read straight
+// from (or nullptr). In the NES, the emulator itself is the bus; anywhere
+// else, a flat one like the following may do.
+
+namespace nes {
+    // A bus with nothing but 64KiB of RAM on it, for running 6502 code
+    // outside of the NES, like the test suites of the other variants
+    struct FlatBus {
+        std::array<uint8_t, 0x10000> memory {};
+
+        uint8_t read(uint16_t addr) const { return memory[addr]; }
+        void write(uint16_t addr, uint8_t data) { memory[addr] = data; }
+        const uint8_t *code_page(uint16_t addr) const {
+            return memory.data() + (addr & 0xFF00);
+        }
+    };
+}
+
 // This class represents the processor used by the NES, a minor variation of
 // the classic 6502 processor. In comparison to the chip-8 "processor" (my
 // previous emulation project), it is one heck of a lot more complicated.
 
 namespace nes {
-    class Processor {
+    template<typename Variant, typename Bus>
+    class BasicProcessor {
         public:
-            // Construct a processor connected to an emulator object
-            Processor(Emulator &bus);
+            // Construct a processor connected to a bus, which the reset
+            // vector is read from right away
+            BasicProcessor(Bus &bus);
 
             // Reset the state of the CPU
             void reset_state();
@@ -39,20 +112,43 @@ namespace nes {
             // Run a single cycle of execution
             void single_step();
 
-            // Show the current state of all registers
-            void show_registers() const;
+            // Get the number of clock cycles executed since the last reset
+            uint64_t get_cycles() const { return cycles; }
+
+            // Get the address of the next instruction to be executed
+            uint16_t get_pc() const { return pc; }
+
+            // Whether the CPU ran into a JAM opcode, which locks it up until
+            // the next reset. It keeps executing the JAM in the meantime
+            bool is_jammed() const { return jammed; }
+
+            // Get a snapshot of the registers
+            CpuState get_state() const;
 
-            // Show next opcode to be executed
-            void show_opcode() const;
+            // Overwrite the registers with the ones in the given snapshot
+            void set_state(const CpuState &state);
 
-            // Show values on the stack, from top to bottom
-            void show_stack() const;
+            // Get the values currently on the stack
+            StackView get_stack() const;
+
+            // Enable or disable the instruction fetch window (on by default).
+            // Like idle loop skipping, it makes no observable difference
+            void set_fetch_window(bool enabled);
+
+            // The memory map changed (a page of program ROM was patched, say),
+            // so the fetch window has to be looked up again
+            void remap() { window_page = no_page; }
+
+            // Run a block of natively compiled code (see native_module.hpp),
+            // which has to start at the current PC. The context only needs
+            // its bus side to be filled in
+            void run_native(const nes_aot_block_info &block, nes_aot_context &ctx);
 
         private:
-            // Reference to the current emulator object, which acts as the main
-            // data bus. Its read and write methods are the primary way for the
+            // Reference to the main data bus (the current emulator object, in
+            // the NES). Its read and write methods are the primary way for the
             // CPU to communicate with other devices in the system
-            Emulator &bus;
+            Bus &bus;
 
             // Index registers: most commonly used to hold counters or offsets
             uint8_t x = 0, y = 0;
@@ -65,6 +161,10 @@ namespace nes {
             // it can be (and is) modified directly for control flow
             uint16_t pc = 0;
 
+            // Number of clock cycles executed since the last reset. For now,
+            // only the base cost of each instruction is taken into account
+            uint64_t cycles = 0;
+
             // The base address of the stack in RAM: it is the last possible
             // address the stack may occupy. The real utility that it has is
             // that you can bitwise OR it with the stack pointer to get the
@@ -75,6 +175,29 @@ namespace nes {
             // free position of the (descending!) stack in RAM
             uint8_t stack_ptr = 0xFF;
 
+            // Set by JAM opcodes, cleared by a reset
+            bool jammed = false;
+
+            // Instructions are fetched through a window onto the 256 byte
+            // page of memory the PC is in, if it is plain memory, so that
+            // fetches are simple loads rather than trips through the bus.
+            // It is looked up again whenever the PC moves to another page;
+            // pages with no window (I/O registers, say) go through the bus
+            static const uint32_t no_page = 0x10000;
+            bool window_enabled = true;
+            const uint8_t *window = nullptr;
+            uint32_t window_page = no_page;
+
+            // Look up the window for the page the PC is in
+            void map_window();
+
+            // Fetch the next byte of the instruction stream
+            uint8_t fetch();
+
+            // Fetch the next two bytes of the instruction stream, as a little
+            // endian word
+            uint16_t fetch_word();
+
             // Push a byte on the stack
             void stack_push(uint8_t byte);
 
@@ -90,7 +213,7 @@ namespace nes {
                 Carry            = (1 << 0),
                 Zero             = (1 << 1),
                 InterruptDisable = (1 << 2),
-                Decimal          = (1 << 3), // no effect in the NES
+                Decimal          = (1 << 3), // no effect in the NES (see Ricoh2A03)
                 Break            = (1 << 4), // no CPU effect
                 Unused           = (1 << 5), // no CPU effect
                 Overflow         = (1 << 6),
@@ -103,30 +226,10 @@ namespace nes {
             // Set the value of a flag in the status register
             void set_flag(Flag flag, bool state);
 
-            // Addressing modes are basically the different "flavors" the same
-            // instruction may come in. They specify how many additional bytes
-            // will be needed beyond the opcode and in which way those bytes,
-            // if present, will be used by the instruction. They can be
-            // uniquely determined from the opcode. Here, they are represented
-            // as an enumeration and a set of addressing-mode-aware functions
-            // for fetching addresses and data.
-
-            enum class Addressing : uint8_t {
-                Null        , // initial, invalid addressing mode
-                Implied     ,
-                Accumulator ,
-                Immediate   ,
-                ZeroPage    ,
-                ZeroPage_x  ,
-                ZeroPage_y  ,
-                Relative    ,
-                Absolute    ,
-                Absolute_x  ,
-                Absolute_y  ,
-                Indirect    ,
-                Indirect_x  ,
-                Indirect_y  ,
-            };
+            // The addressing mode of an instruction (see opcodes.hpp) tells
+            // where its data comes from. Here, it is tracked through a member
+            // and a set of addressing-mode-aware functions for fetching
+            // addresses and data.
 
             // Current addressing mode, should be reset for every instruction
             Addressing addr_mode = Addressing::Null;
@@ -168,6 +271,14 @@ namespace nes {
             void inst_pla();
             void inst_plp();
 
+            // Arithmetic instructions, plus the decimal mode helpers they
+            // use on the variants that have it:
+            void inst_adc();
+            void inst_sbc();
+            void add(uint8_t data);
+            void add_decimal(uint8_t data);
+            void subtract_decimal(uint8_t data);
+
             // Logic instructions:
             void inst_and();
             void inst_eor();
@@ -195,7 +306,8 @@ namespace nes {
             void inst_jsr();
             void inst_rts();
 
-            // Branch instructions:
+            // Branch instructions, which all go through the same helper:
+            void branch(bool taken);
             void inst_bcc();
             void inst_bcs();
             void inst_beq();
@@ -216,10 +328,19 @@ namespace nes {
             void inst_cld() { set_flag(Flag::Decimal          , false); }
             void inst_clv() { set_flag(Flag::Overflow         , false); }
 
+            // Illegal instruction which locks up the NMOS chips (the 65C02
+            // has other uses for its opcodes, which are left out for now)
+            void inst_jam();
+
             // TODO:
-            // - arithmetic instructions
+            // - compare instructions
             // - interrupt related instructions (BRK and RTI)
     };
+
+    // The NES' own processor, which is the only one the emulator uses. The
+    // other variants are built too, on a FlatBus (see processor.cpp), for
+    // reuse elsewhere
+    using Processor = BasicProcessor<Ricoh2A03, Emulator>;
 }
 
 #endif // NES_PROCESSOR_HPP
@@ -0,0 +1,75 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_RECOMPILER_HPP
+#define NES_RECOMPILER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "disassembler.hpp"
+
+namespace nes { class Emulator; }
+
+// Recompilation of 6502 code into C++, which is then compiled into a shared
+// object by the system's compiler and loaded back by NativeModule (see
+// native_module.hpp). Code is recompiled in blocks of straight line code, and
+// only the instructions the interpreter implements are recompiled, with the
+// exact same behavior; anything else is left to the interpreter. Ahead of
+// time, only code in program ROM is recompiled; on the fly (see tiering.hpp),
+// code in program RAM is too, as it can be invalidated when it changes.
+
+namespace nes {
+    // A block of straight line code. It ends with a jump, branch or return,
+    // or right before the start of another block or an instruction which
+    // cannot be recompiled
+    struct CodeBlock {
+        uint16_t addr = 0;
+        std::vector<Instruction> instructions;
+    };
+
+    // Whether the recompiler can handle the given opcode
+    bool can_recompile(uint8_t opcode);
+
+    // Split the code found by the disassembler into blocks. Blocks start at
+    // the interrupt vectors, at the targets of jumps and branches and right
+    // after them, so that every common way into the code starts a block
+    std::vector<CodeBlock> find_blocks(const Emulator &nes_emu,
+            const std::vector<Instruction> &listing);
+
+    // Decode the block of code starting at the given address ($6000 up), as
+    // it is right now. Blocks in program RAM stop short of any instruction
+    // that might write outside of RAM, and so possibly to themselves
+    CodeBlock decode_block(const Emulator &nes_emu, uint16_t addr);
+
+    // Emit the C++ source of a module containing the given blocks
+    std::string emit_module(const std::vector<CodeBlock> &blocks, uint64_t rom_hash);
+
+    // Compile a module's source into a shared object, with the given compiler
+    // command and directory holding aot_abi.h. Returns false on failure
+    bool compile_module(const std::string &source_path, const std::string &output,
+            const std::string &compiler, const std::string &include_dir);
+
+    // The compiler command to use by default: $CXX, or c++ if it isn't set
+    std::string default_compiler();
+
+    // The directory holding aot_abi.h, as far as this build knows
+    std::string default_include_dir();
+}
+
+#endif // NES_RECOMPILER_HPP
@@ -0,0 +1,122 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_RECORDER_HPP
+#define NES_RECORDER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streaming of raw video (YUV4MPEG2) and audio (WAV) to files or pipes, for
+// encoding offline. Encoding happens on the emulation thread, but all of the
+// writing is done by a background thread, so that a slow consumer does not
+// slow emulation down until the bounded queue between them fills up.
+
+namespace nes {
+    // Writes chunks of bytes to a file from a background thread. Chunk
+    // buffers are recycled, so that steady state streaming does not allocate
+    class AsyncWriter {
+        public:
+            // Open the given file for writing ("-" means stdout). At most
+            // max_pending chunks may be waiting to be written at any time
+            AsyncWriter(const std::string &path, size_t max_pending = 8);
+
+            // Write out whatever is still pending and close the file
+            ~AsyncWriter();
+
+            AsyncWriter(const AsyncWriter&) = delete;
+            AsyncWriter &operator=(const AsyncWriter&) = delete;
+
+            // Whether the file was successfully opened, and every write to it
+            // has succeeded so far
+            bool is_ok() const { return file != nullptr && !failed; }
+
+            // Get an empty buffer to fill in and pass to submit
+            std::vector<uint8_t> acquire();
+
+            // Queue a chunk for writing. This only blocks if the queue is full
+            void submit(std::vector<uint8_t> &&chunk);
+
+        private:
+            FILE *file;
+            std::atomic<bool> failed {false};
+            bool done = false;
+            size_t max_pending;
+            std::deque<std::vector<uint8_t>> pending;
+            std::vector<std::vector<uint8_t>> spare;
+            std::mutex mutex;
+            std::condition_variable not_empty, not_full;
+            std::thread worker;
+
+            // Body of the background thread
+            void run();
+    };
+
+    // Convert palette indices, as a PPU would output them, to the Y, Cb and
+    // Cr planes of a picture. Byte shuffles do the lookups 16 or 32 pixels at
+    // a time, on CPUs that have them (SSSE3, AVX2 or NEON)
+    void palette_to_yuv(const uint8_t *indices, size_t count,
+            uint8_t *y, uint8_t *cb, uint8_t *cr);
+
+    // The same, one pixel at a time. This is what the above must match
+    void palette_to_yuv_scalar(const uint8_t *indices, size_t count,
+            uint8_t *y, uint8_t *cb, uint8_t *cr);
+
+    // Streams frames of palette indices, as a PPU would output them, as
+    // YUV4MPEG2 video in 4:4:4 format
+    class VideoRecorder {
+        public:
+            static const int width = 256, height = 240;
+
+            VideoRecorder(const std::string &path);
+
+            bool is_ok() const { return out.is_ok(); }
+
+            // Convert a frame of width * height palette indices and queue it
+            void add_frame(const uint8_t *indices);
+
+        private:
+            AsyncWriter out;
+    };
+
+    // Streams signed 16-bit mono samples as a WAV file. The sizes in the
+    // header are left at their maximum, as they cannot be known in advance
+    // (and a pipe could not be rewound to fix them anyway)
+    class AudioRecorder {
+        public:
+            AudioRecorder(const std::string &path, uint32_t sample_rate);
+
+            bool is_ok() const { return out.is_ok(); }
+
+            // Queue a batch of samples
+            void add_samples(const int16_t *samples, size_t count);
+
+        private:
+            AsyncWriter out;
+    };
+}
+
+#endif // NES_RECORDER_HPP
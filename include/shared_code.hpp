@@ -0,0 +1,149 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_SHARED_CODE_HPP
+#define NES_SHARED_CODE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "aot_abi.h"
+
+// Natively compiled program ROM code, shared by every emulator in the process
+// running the same ROM. When a batch job runs hundreds of instances of a game
+// side by side, each block is then only compiled and loaded once: whichever
+// instance gets hot on it first claims it, and once it is compiled, all of
+// them run it. Blocks only keep their state in the context they are passed,
+// so any instance can run any of them.
+//
+// Lookups don't take any locks. The number of blocks is bounded, and once
+// there are too many, the modules that weren't run for the longest time
+// (roughly; see evict()) are dropped. As another instance may be running one
+// of their blocks at that very moment, they are only unloaded once every
+// instance got to the end of a frame, where none is.
+
+namespace nes {
+    class SharedCode {
+        public:
+            // An instance running the shared code. It tells when it isn't
+            // running any of it through quiescent()
+            class Reader {
+                friend class SharedCode;
+                std::atomic<uint64_t> seen { 0 };
+            };
+
+            // The shared code for the ROM with the given hash, created if no
+            // other instance has it yet
+            static std::shared_ptr<SharedCode> get(uint64_t rom_hash);
+
+            // Maximum number of blocks kept at once, for every ROM
+            static void set_capacity(size_t blocks);
+
+            explicit SharedCode(uint64_t rom_hash) : rom_hash(rom_hash) {}
+            ~SharedCode();
+
+            SharedCode(const SharedCode&) = delete;
+            SharedCode &operator=(const SharedCode&) = delete;
+
+            // Get the block starting at the given address, if there is one
+            const nes_aot_block_info *find(uint16_t addr) const {
+                if(addr < 0x8000) return nullptr;
+                const Slot *slot = table[addr - 0x8000].load(std::memory_order_acquire);
+                if(!slot) return nullptr;
+                // Checked first, so that hot modules don't keep getting
+                // their cache line written to
+                if(!slot->module->referenced.load(std::memory_order_relaxed))
+                    slot->module->referenced.store(true, std::memory_order_relaxed);
+                return slot->block;
+            }
+
+            // Claim the block at the given address for compiling. Returns
+            // false if it is already claimed, by this instance or another
+            bool claim(uint16_t addr) {
+                return addr >= 0x8000 && !claimed[addr - 0x8000].exchange(true);
+            }
+
+            // Give up on a claimed block, which won't be compiled after all
+            void release(uint16_t addr) {
+                if(addr >= 0x8000) claimed[addr - 0x8000].store(false);
+            }
+
+            // Whether the block at the given address is claimed
+            bool is_claimed(uint16_t addr) const {
+                return addr >= 0x8000 && claimed[addr - 0x8000].load(std::memory_order_relaxed);
+            }
+
+            // Load a module with claimed blocks and share them. Returns false
+            // if it can't be used, in which case the claims are released
+            bool publish(const std::string &path, const std::vector<uint16_t> &claims);
+
+            // Number of times modules were evicted. Blocks evicted are no
+            // longer claimed, so they may be compiled again
+            uint64_t evictions() const { return eviction_count.load(std::memory_order_acquire); }
+
+            // Register and unregister an instance running the shared code
+            void attach(Reader &reader);
+            void detach(Reader &reader);
+
+            // The given instance isn't running any shared code right now
+            void quiescent(Reader &reader) {
+                reader.seen.store(epoch.load());
+                if(retiring.load(std::memory_order_relaxed)) reclaim();
+            }
+
+        private:
+            struct Module;
+            struct Slot {
+                const nes_aot_block_info *block;
+                Module *module;
+            };
+            struct Module {
+                void *handle = nullptr;
+                std::vector<Slot> slots;
+                std::atomic<bool> referenced { true };
+                // Epoch at which it was evicted
+                uint64_t retired = 0;
+            };
+
+            uint64_t rom_hash;
+            std::array<std::atomic<const Slot*>, 0x8000> table {};
+            std::array<std::atomic<bool>, 0x8000> claimed {};
+
+            // Everything below is only changed with the mutex held
+            std::mutex mutex;
+            std::vector<std::unique_ptr<Module>> resident, retired;
+            std::vector<Reader*> readers;
+            size_t blocks = 0, hand = 0;
+            std::atomic<uint64_t> epoch { 0 }, eviction_count { 0 };
+            std::atomic<bool> retiring { false };
+
+            // Drop modules until there are few enough blocks again. This is
+            // the CLOCK algorithm: modules are swept in turn, and those which
+            // had a block run since the last sweep get another chance
+            void evict();
+
+            // Unload the evicted modules no instance may be running anymore
+            void reclaim();
+    };
+}
+
+#endif // NES_SHARED_CODE_HPP
@@ -0,0 +1,84 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_SHARED_EXPORT_HPP
+#define NES_SHARED_EXPORT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Export of the console's observable state through a POSIX shared memory
+// segment, so that other processes on the same machine (recorders, trainers,
+// dashboards) can read it straight from the mapping, without sockets or
+// copies of their own. The segment is updated at the end of every frame.
+//
+// Readers should follow the sequence counter protocol: read the counter, and
+// if it is odd, an update is under way, so try again later; otherwise read
+// what you need and then read the counter again. If it changed, the data may
+// be torn and should be read again.
+
+namespace nes {
+    // Layout of the shared memory segment. It only uses fixed size types, so
+    // that readers in other languages can easily mirror it
+    struct SharedSegment {
+        char magic[8];              // "LIBRENES"
+        uint32_t version;           // layout version, currently 1
+        uint32_t ram_size;          // size of the RAM mirror, in bytes
+        uint32_t prg_ram_size;      // size of the program RAM mirror
+        uint32_t framebuffer_size;  // 0 until there is a PPU
+        uint32_t audio_size;        // 0 until there is an APU
+        uint32_t reserved;
+        std::atomic<uint64_t> sequence; // odd while an update is under way
+        uint64_t frame;             // number of frames run so far
+        uint8_t ram[0x0800];
+        uint8_t prg_ram[0x2000];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+            "the sequence counter has to work across processes");
+
+    class Emulator;
+
+    class SharedExport {
+        public:
+            // Create the shared memory segment with the given name, which has
+            // to start with a slash and must not be in use already. Check
+            // is_open afterwards
+            SharedExport(const std::string &name);
+
+            // The segment is unlinked when its creator goes away
+            ~SharedExport();
+
+            SharedExport(const SharedExport&) = delete;
+            SharedExport &operator=(const SharedExport&) = delete;
+
+            // Whether the segment was successfully created
+            bool is_open() const { return segment != nullptr; }
+
+            // Copy the current state of the console into the segment
+            void publish(const Emulator &nes_emu);
+
+        private:
+            std::string name;
+            SharedSegment *segment = nullptr;
+    };
+}
+
+#endif // NES_SHARED_EXPORT_HPP
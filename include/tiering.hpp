@@ -0,0 +1,155 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_TIERING_HPP
+#define NES_TIERING_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "code_cache.hpp"
+#include "recompiler.hpp"
+#include "shared_code.hpp"
+
+namespace nes { class Emulator; class NativeModule; }
+
+// Tiered execution: everything starts out in the interpreter, which counts
+// how many times each instruction in program RAM and ROM runs. Once one gets
+// hot, the block starting there is handed to a background thread, which
+// recompiles it (together with whatever else got hot in the meantime) and
+// compiles the result with the system's compiler. Finished modules are picked
+// up by the emulator's thread and their blocks are used from then on. Cold
+// code, like boot code and menus, never pays for any of this, and nothing
+// ever waits for the compiler.
+//
+// Blocks compiled from program RAM are dropped when it is written to, and
+// may be promoted again once they get hot again, unless that keeps happening,
+// in which case they stay in the interpreter for good.
+//
+// Code in program ROM is compiled for every instance running the same ROM at
+// once (see shared_code.hpp), so only the first one to get hot on it does.
+//
+// With a cache directory (see code_cache.hpp), code in program ROM that got
+// hot on an earlier run is compiled as soon as execution starts, and when it
+// was already compiled the same way, the module is loaded from the cache.
+
+namespace nes {
+    class TieredCompiler {
+        public:
+            // Number of times an instruction has to run to get promoted
+            static const uint16_t promote_threshold = 1024;
+
+            // Number of times a block may be invalidated before getting
+            // demoted to the interpreter for good
+            static const uint8_t demote_threshold = 4;
+
+            // Compile blocks into the given module, with the given compiler
+            // command and directory holding aot_abi.h, and cache directory,
+            // if any
+            TieredCompiler(const Emulator &nes_emu, NativeModule &native,
+                    const std::string &compiler, const std::string &include_dir,
+                    const std::string &cache_dir = "");
+            ~TieredCompiler();
+
+            // Whether a scratch directory for the compiler could be created,
+            // and the cache opened, if there is one
+            bool ok() const { return !dir.empty() && (!cache || cache->ok()); }
+
+            // Count a run of the instruction at the given address, which the
+            // interpreter is about to execute
+            void count(uint16_t addr) {
+                if(addr < base) return;
+                uint16_t &h = heat[addr - base];
+                if(h < promote_threshold && ++h == promote_threshold) promote(addr);
+            }
+
+            // Start using whatever finished compiling. Costs next to nothing
+            // when nothing did
+            void poll() {
+                if(ready.load(std::memory_order_acquire)) install();
+                if(shared && shared->evictions() != evictions_seen) rewarm();
+            }
+
+            // Blocks starting at these addresses were invalidated
+            void invalidated(const std::vector<uint16_t> &addrs);
+
+        private:
+            const Emulator &nes_emu;
+            NativeModule &native;
+            SharedCode *shared;
+            uint64_t evictions_seen = 0;
+            std::string compiler, include_dir;
+            uint64_t rom_hash;
+
+            // Execution counts and invalidation counts, from program RAM up
+            static const uint16_t base = 0x6000;
+            std::array<uint16_t, 0x10000 - base> heat {};
+            std::array<uint8_t, 0x10000 - base> invalidations {};
+
+            // Scratch directory for sources and modules
+            std::string dir;
+
+            // Where modules are kept across runs, if anywhere
+            std::unique_ptr<CodeCache> cache;
+
+            // Blocks waiting to be compiled, for this instance only or to be
+            // shared, and modules done compiling, along with the blocks they
+            // were compiled from. Only the first batch, with the code that got
+            // hot on earlier runs, is cached; the rest depend too much on
+            // timing to ever be compiled the same way again
+            struct Batch {
+                std::vector<CodeBlock> blocks;
+                std::string path;
+                bool compiled = false;
+                bool cached = false;
+                bool shared = false;
+            };
+            Batch pending, pending_shared;
+            std::vector<Batch> done;
+            std::atomic<bool> ready { false };
+            bool quit = false;
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::thread worker;
+
+            // Hand the block at the given address to the worker
+            void promote(uint16_t addr);
+
+            // Load finished modules
+            void install();
+
+            // Shared blocks were evicted, so let whatever we don't have a
+            // block for anymore get hot again
+            void rewarm();
+
+            // The worker thread's main loop
+            void work();
+
+            // Compile a batch of blocks, from the given source, into a module
+            // in the scratch directory or the cache
+            void build(Batch &batch, const std::string &code, unsigned serial);
+    };
+}
+
+#endif // NES_TIERING_HPP
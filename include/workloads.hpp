@@ -0,0 +1,39 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_WORKLOADS_HPP
+#define NES_WORKLOADS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic workloads: tiny NROM images, built on the fly, each spending its
+// time in one kind of instruction. They make for benchmarks that need no
+// external ROMs, and for the training corpus of profile-guided builds.
+
+namespace nes {
+    // Names of the available workloads
+    extern const std::vector<std::string> workload_names;
+
+    // Build the iNES image of the named workload. Returns false if there is
+    // no workload with that name
+    bool build_workload(const std::string &name, std::vector<uint8_t> &image);
+}
+
+#endif // NES_WORKLOADS_HPP
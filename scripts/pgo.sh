@@ -0,0 +1,37 @@
+#!/bin/sh
+#
+# Build libre-nes with profile-guided optimization. An instrumented build is
+# made first, the benchmarks in the 'pgo' suite (the synthetic workloads, plus
+# any ROMs listed in PGO_ROMS) are run on it to collect a profile, and then
+# everything is rebuilt using that profile.
+#
+# Usage: scripts/pgo.sh [BUILD_DIR]
+
+set -e
+
+build=${1:-build-pgo}
+source_dir=$(dirname "$0")/..
+
+if [ -d "$build" ]; then
+    meson configure "$build" -Dbuildtype=release -Db_pgo=generate
+else
+    meson setup "$build" "$source_dir" -Dbuildtype=release -Db_pgo=generate
+fi
+meson compile -C "$build"
+
+# Stale profile data would be merged with the new one
+find "$build" \( -name '*.gcda' -o -name '*.profraw' \) -delete
+export LLVM_PROFILE_FILE="$(cd "$build" && pwd)/pgo-%p.profraw"
+meson test -C "$build" --benchmark --suite pgo
+for rom in $PGO_ROMS; do
+    "$build/libre-nes-bench" --rom "$rom" --frames 600 > /dev/null
+done
+
+# Clang leaves raw profiles behind, which have to be merged by hand. GCC
+# writes its .gcda files right where -fprofile-use looks for them
+if ls "$build"/*.profraw > /dev/null 2>&1; then
+    llvm-profdata merge -output="$build/default.profdata" "$build"/*.profraw
+fi
+
+meson configure "$build" -Db_pgo=use
+meson compile -C "$build"
@@ -0,0 +1,102 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "disassembler.hpp"
+#include "emulator.hpp"
+#include "recompiler.hpp"
+
+// Ahead of time recompiler: finds the code in a ROM by following its control
+// flow from the interrupt vectors (plus any other entry points given), turns
+// it into C++ and compiles that into a module that the emulator can load with
+// --backend native --module FILE. Code the disassembler could not reach, such
+// as code only reached through jump tables, is left to the interpreter.
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " --rom FILE --output FILE [options]\n"
+        "  --rom FILE          iNES image to recompile\n"
+        "  --output FILE       shared object to write\n"
+        "  --source FILE       where to keep the generated C++ (default: the\n"
+        "                      output with .cpp appended)\n"
+        "  --entry ADDR        extra entry point, in hex; may be repeated\n"
+        "  --cxx COMMAND       compiler to use (default: $CXX, or c++)\n"
+        "  --include-dir DIR   directory containing aot_abi.h\n";
+}
+
+int main(int argc, char *argv[]) {
+    std::string rom, output, source, include_dir = nes::default_include_dir();
+    std::string compiler = nes::default_compiler();
+    std::vector<uint16_t> entries;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(arg == "--rom") rom = argv[++i];
+        else if(arg == "--output") output = argv[++i];
+        else if(arg == "--source") source = argv[++i];
+        else if(arg == "--entry") entries.push_back(std::strtoul(argv[++i], nullptr, 16));
+        else if(arg == "--cxx") compiler = argv[++i];
+        else if(arg == "--include-dir") include_dir = argv[++i];
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(rom.empty() || output.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(source.empty()) source = output + ".cpp";
+
+    nes::Emulator nes_emu;
+    if(!nes_emu.load_rom_file(rom))
+        return EXIT_FAILURE;
+    nes::Disassembler disassembler(nes_emu);
+    for(uint16_t entry : entries)
+        disassembler.add_entry(entry);
+    const auto &listing = disassembler.disassemble();
+    std::vector<nes::CodeBlock> blocks = nes::find_blocks(nes_emu, listing);
+
+    {
+        std::ofstream file(source);
+        file << nes::emit_module(blocks, nes_emu.hash_prg_rom());
+        if(!file) {
+            std::cerr << "Could not write " << source << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    if(!nes::compile_module(source, output, compiler, include_dir)) {
+        std::cerr << "Could not compile " << source << '\n';
+        return EXIT_FAILURE;
+    }
+
+    size_t instructions = 0;
+    for(const nes::CodeBlock &block : blocks)
+        instructions += block.instructions.size();
+    printf("%zu blocks, %zu of %zu instructions found recompiled\n", blocks.size(),
+            instructions, listing.size());
+    return EXIT_SUCCESS;
+}
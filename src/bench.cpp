@@ -0,0 +1,257 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "emulator.hpp"
+#include "recompiler.hpp"
+#include "workloads.hpp"
+
+// Headless benchmark: runs a ROM for a fixed number of frames, with no output
+// whatsoever, and reports the throughput as JSON on stdout. If a baseline file
+// (the JSON output of a previous run) is given, the run fails when the frame
+// rate regresses beyond the allowed threshold. Startup latency, from process
+// start to the end of the first emulated frame, is reported as well, broken
+// down by phase, since it dominates short batch jobs.
+
+using Clock = std::chrono::steady_clock;
+
+// When the process started, worked out from the current time. Everything up
+// to main (exec, dynamic linking of libnes, static initialization) runs on a
+// single thread, so the CPU time spent so far is a fine grained measure of
+// it. It misses any time spent blocked, on a cold page cache say, which the
+// kernel's record of the start time in /proc/self/stat catches, if only to
+// the nearest clock tick. The latter wins whenever it is more than a tick
+// longer
+static Clock::time_point process_start_time() {
+    Clock::time_point now = Clock::now();
+    timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    double elapsed = cpu.tv_sec + cpu.tv_nsec / 1e9;
+
+    std::ifstream file("/proc/self/stat");
+    std::string stat;
+    std::getline(file, stat);
+    // The command name may contain spaces, so fields are counted from the
+    // parenthesis that closes it. The start time is the 22nd field, in clock
+    // ticks since boot
+    size_t paren = stat.rfind(')');
+    unsigned long long start_ticks = 0;
+    if(paren != std::string::npos) {
+        std::istringstream fields(stat.substr(paren + 1));
+        std::string field;
+        for(int i = 3; i <= 22 && fields >> field; ++i)
+            if(i == 22) start_ticks = std::strtoull(field.c_str(), nullptr, 10);
+    }
+    long ticks_per_second = sysconf(_SC_CLK_TCK);
+    timespec boot;
+    if(start_ticks > 0 && ticks_per_second > 0 && clock_gettime(CLOCK_BOOTTIME, &boot) == 0) {
+        double tick = 1.0 / ticks_per_second;
+        double since_start = boot.tv_sec + boot.tv_nsec / 1e9 - start_ticks * tick;
+        if(since_start - tick > elapsed) elapsed = since_start;
+    }
+    return now - std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(elapsed));
+}
+
+static double ms_between(Clock::time_point begin, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+// The names of the synthetic workloads, as a list for humans
+static std::string workload_list() {
+    std::string list;
+    for(size_t i = 0; i < nes::workload_names.size(); ++i) {
+        if(i > 0) list += i + 1 < nes::workload_names.size() ? ", " : " or ";
+        list += nes::workload_names[i];
+    }
+    return list;
+}
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " (--rom FILE | --synthetic NAME) [options]\n"
+        "  --rom FILE          iNES image to run\n"
+        "  --synthetic NAME    built-in workload to run instead of a ROM\n"
+        "                      (" << workload_list() << ")\n"
+        "  --frames N          number of frames to run (default: 600)\n"
+        "  --backend NAME      CPU backend to use: interpreter (the default),\n"
+        "                      native, which needs --module, or tiered, which\n"
+        "                      compiles hot code on the fly\n"
+        "  --module FILE       native code module, from libre-nes-aot\n"
+        "  --cache DIR         keep compiled code in DIR across runs, for the\n"
+        "                      tiered backend\n"
+        "  --baseline FILE     compare against a previous run's output\n"
+        "  --threshold RATIO   allowed slowdown against the baseline\n"
+        "                      (default: 0.05, that is, 5%)\n"
+        "  --stop-on-halt      stop early if the program crashes, that is, runs\n"
+        "                      into a JAM opcode or gets stuck in a loop\n"
+        "Exits with 2 if the frame rate regressed beyond the threshold.\n";
+}
+
+// Fish the frame rate out of a previous run's JSON output. There is no need
+// for a real JSON parser, as we know exactly what that output looks like
+static bool read_baseline(const std::string &path, double &fps) {
+    std::ifstream file(path);
+    if(!file) return false;
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string json = contents.str();
+    const char *key = "\"frames_per_second\":";
+    size_t pos = json.find(key);
+    if(pos == std::string::npos) return false;
+    fps = std::strtod(json.c_str() + pos + std::strlen(key), nullptr);
+    return fps > 0;
+}
+
+int main(int argc, char *argv[]) {
+    auto main_start = Clock::now();
+    auto process_start = process_start_time();
+    std::string rom, synthetic, backend = "interpreter", baseline, module, cache;
+    uint64_t frames = 600;
+    double threshold = 0.05;
+    bool stop_on_halt = false;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--stop-on-halt") {
+            stop_on_halt = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(arg == "--rom") rom = argv[++i];
+        else if(arg == "--synthetic") synthetic = argv[++i];
+        else if(arg == "--frames") frames = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--backend") backend = argv[++i];
+        else if(arg == "--module") module = argv[++i];
+        else if(arg == "--cache") cache = argv[++i];
+        else if(arg == "--baseline") baseline = argv[++i];
+        else if(arg == "--threshold") threshold = std::strtod(argv[++i], nullptr);
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(rom.empty() == synthetic.empty() || frames == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(!synthetic.empty() && std::find(nes::workload_names.begin(),
+                nes::workload_names.end(), synthetic) == nes::workload_names.end()) {
+        std::cerr << "Unknown workload: " << synthetic << " (try "
+            << workload_list() << ")\n";
+        return EXIT_FAILURE;
+    }
+    if(backend != "interpreter" && backend != "native" && backend != "tiered") {
+        std::cerr << "Unknown backend: " << backend << '\n';
+        return EXIT_FAILURE;
+    }
+    if((backend == "native") == module.empty()) {
+        std::cerr << "A native code module goes with the native backend\n";
+        return EXIT_FAILURE;
+    }
+    if(!cache.empty() && backend != "tiered") {
+        std::cerr << "A code cache goes with the tiered backend\n";
+        return EXIT_FAILURE;
+    }
+
+    auto construct_start = Clock::now();
+    nes::Emulator nes_emu;
+    auto load_start = Clock::now();
+    if(!synthetic.empty()) {
+        std::vector<uint8_t> image;
+        nes::build_workload(synthetic, image);
+        rom = "synthetic:" + synthetic;
+        if(!nes_emu.load_rom(image.data(), image.size()))
+            return EXIT_FAILURE;
+    } else if(!nes_emu.load_rom_file(rom)) {
+        return EXIT_FAILURE;
+    }
+    if(!module.empty() && !nes_emu.load_native(module))
+        return EXIT_FAILURE;
+    if(backend == "tiered" && !nes_emu.enable_tiering(nes::default_compiler(),
+                nes::default_include_dir(), cache))
+        return EXIT_FAILURE;
+
+    nes_emu.set_halt_detection(stop_on_halt);
+
+    auto begin = Clock::now();
+    uint64_t instructions = nes_emu.run_frame();
+    auto first_frame = Clock::now();
+    for(uint64_t i = 1; i < frames && !nes_emu.is_halted(); ++i)
+        instructions += nes_emu.run_frame();
+    auto end = Clock::now();
+    // The rates below only count the frames that were actually run
+    frames = nes_emu.get_frame();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+
+    // On Linux, the maximum resident set size is given in KiB
+    struct rusage res;
+    getrusage(RUSAGE_SELF, &res);
+
+    double fps = frames / seconds;
+    printf("{\n");
+    printf("  \"rom\": \"%s\",\n", rom.c_str());
+    printf("  \"backend\": \"%s\",\n", backend.c_str());
+    printf("  \"frames\": %llu,\n", (unsigned long long) frames);
+    printf("  \"seconds\": %.6f,\n", seconds);
+    printf("  \"frames_per_second\": %.3f,\n", fps);
+    printf("  \"instructions_per_second\": %.3f,\n", instructions / seconds);
+    printf("  \"peak_rss_kib\": %ld,\n", res.ru_maxrss);
+    if(nes_emu.is_halted())
+        printf("  \"halted\": {\"pc\": %u, \"frame\": %llu},\n", nes_emu.get_halt_pc(),
+                (unsigned long long) nes_emu.get_halt_frame());
+    printf("  \"startup\": {\n");
+    printf("    \"to_main_ms\": %.3f,\n", ms_between(process_start, main_start));
+    printf("    \"construct_ms\": %.3f,\n", ms_between(construct_start, load_start));
+    printf("    \"load_ms\": %.3f,\n", ms_between(load_start, begin));
+    printf("    \"first_frame_ms\": %.3f,\n", ms_between(begin, first_frame));
+    printf("    \"total_ms\": %.3f\n", ms_between(process_start, first_frame));
+    printf("  }\n");
+    printf("}\n");
+
+    if(nes_emu.is_halted())
+        fprintf(stderr, "Halted at $%04X on frame %llu\n", nes_emu.get_halt_pc(),
+                (unsigned long long) nes_emu.get_halt_frame());
+
+    if(baseline.empty())
+        return EXIT_SUCCESS;
+    double baseline_fps;
+    if(!read_baseline(baseline, baseline_fps)) {
+        std::cerr << "Could not read baseline from " << baseline << '\n';
+        return EXIT_FAILURE;
+    }
+    if(fps < baseline_fps * (1.0 - threshold)) {
+        fprintf(stderr, "Regression: %.3f frames/s against a baseline of %.3f\n",
+                fps, baseline_fps);
+        return 2;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include "cartridge.hpp"
+
+using namespace nes;
+
+bool Cartridge::load(const uint8_t *image, size_t size) {
+    // The iNES header is 16 bytes long and starts with "NES\x1A"
+    if(size < 16 || image[0] != 'N' || image[1] != 'E' || image[2] != 'S'
+            || image[3] != 0x1A) {
+        std::cerr << "Not an iNES image!\n";
+        return false;
+    }
+    size_t prg_size = image[4] * 0x4000; // in units of 16KiB
+    size_t chr_size = image[5] * 0x2000; // in units of 8KiB
+    uint8_t mapper = (image[6] >> 4) | (image[7] & 0xF0);
+    if(mapper != 0) {
+        std::cerr << "Unsupported mapper: " << (int) mapper << '\n';
+        return false;
+    }
+    if(prg_size != 0x4000 && prg_size != 0x8000) {
+        std::cerr << "Invalid program ROM size for NROM!\n";
+        return false;
+    }
+
+    // A 512 byte trainer may sit between the header and the program ROM.
+    // It was only ever used by copier hardware, so we just skip over it
+    size_t offset = 16;
+    if(image[6] & 0x04) offset += 512;
+    if(size < offset + prg_size + chr_size) {
+        std::cerr << "Truncated iNES image!\n";
+        return false;
+    }
+    prg_rom.assign(image + offset, image + offset + prg_size);
+    offset += prg_size;
+    chr_rom.assign(image + offset, image + offset + chr_size);
+    prg_mask = prg_size - 1;
+    prg_ram.fill(0);
+    clear_patches();
+    return true;
+}
+
+uint8_t Cartridge::read(uint16_t addr) const {
+    if(addr < 0x8000)
+        return prg_ram[addr & 0x1FFF];
+    return prg_pages[(addr >> 8) & (page_count - 1)][addr & 0xFF];
+}
+
+void Cartridge::write(uint16_t addr, uint8_t data) {
+    if(addr >= 0x6000 && addr < 0x8000)
+        prg_ram[addr & 0x1FFF] = data;
+}
+
+bool Cartridge::patch(uint16_t addr, uint8_t value, int compare) {
+    if(!is_loaded() || addr < 0x8000) return false;
+    unsigned page = (addr >> 8) & (page_count - 1);
+    if(compare >= 0 && prg_rom[addr & prg_mask] != compare) return false;
+    auto it = patched_pages.find(page);
+    if(it == patched_pages.end()) {
+        // First patch to this page: copy it and map the copy in its place.
+        // Only this page is affected, not its mirror, if there is one
+        it = patched_pages.emplace(page, std::array<uint8_t, 0x100>()).first;
+        std::copy(prg_pages[page], prg_pages[page] + 0x100, it->second.begin());
+        prg_pages[page] = it->second.data();
+    }
+    it->second[addr & 0xFF] = value;
+    return true;
+}
+
+void Cartridge::clear_patches() {
+    patched_pages.clear();
+    for(unsigned page = 0; page < page_count; ++page)
+        prg_pages[page] = prg_rom.data() + ((page << 8) & prg_mask);
+}
@@ -0,0 +1,71 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "cheats.hpp"
+
+using namespace nes;
+
+// Game Genie codes are made of these letters, each one standing for a nibble
+static const char genie_letters[] = "APZLGITYEOXUKSVN";
+
+static bool parse_genie(const std::string &code, Cheat &cheat) {
+    if(code.size() != 6 && code.size() != 8) return false;
+    int n[8];
+    for(size_t i = 0; i < code.size(); ++i) {
+        // Uppercasing turns a space (or a NUL) into the NUL at the end of
+        // the letters, which strchr would happily find
+        char upper = code[i] & ~0x20;
+        const char *letter = upper ? strchr(genie_letters, upper) : nullptr;
+        if(!letter) return false;
+        n[i] = letter - genie_letters;
+    }
+    // The bits of the address and values are scrambled all over the code
+    cheat.addr = 0x8000 | ((n[3] & 7) << 12) | ((n[5] & 7) << 8) | ((n[4] & 8) << 8)
+        | ((n[2] & 7) << 4) | ((n[1] & 8) << 4) | (n[4] & 7) | (n[3] & 8);
+    cheat.value = ((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7);
+    if(code.size() == 6) {
+        cheat.value |= n[5] & 8;
+        cheat.compare = -1;
+    } else {
+        cheat.value |= n[7] & 8;
+        cheat.compare = ((n[7] & 7) << 4) | ((n[6] & 8) << 4) | (n[6] & 7) | (n[5] & 8);
+    }
+    return true;
+}
+
+static bool parse_raw(const std::string &code, Cheat &cheat) {
+    // Up to four hex digits of address and two of value
+    size_t colon = code.find(':');
+    size_t digits = code.size() - colon - 1;
+    if(colon == 0 || colon > 4 || digits == 0 || digits > 2
+            || code.find_first_not_of("0123456789ABCDEFabcdef", colon + 1) != std::string::npos
+            || code.find_first_not_of("0123456789ABCDEFabcdef") != colon)
+        return false;
+    cheat.addr = strtoul(code.substr(0, colon).c_str(), nullptr, 16);
+    cheat.value = strtoul(code.c_str() + colon + 1, nullptr, 16);
+    cheat.compare = -1;
+    return true;
+}
+
+bool nes::parse_cheat(const std::string &code, Cheat &cheat) {
+    if(code.find(':') != std::string::npos)
+        return parse_raw(code, cheat);
+    return parse_genie(code, cheat);
+}
@@ -0,0 +1,112 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "aot_abi.h"
+#include "code_cache.hpp"
+#include "hash.hpp"
+
+using namespace nes;
+
+// Bumped whenever the layout of the map changes
+static const uint32_t map_version = 1;
+
+CodeCache::CodeCache(const std::string &dir, uint64_t rom_hash) : dir(dir) {
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(rom_hash));
+    prefix = name;
+
+    if(mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "Could not create cache directory " << dir << '\n';
+        return;
+    }
+    std::string path = dir + "/" + prefix + ".map";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        std::cerr << "Could not open code map " << path << '\n';
+        return;
+    }
+    // Growing the file zero fills it, and doing so again is harmless, so
+    // it doesn't matter which process gets here first
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (st.st_size < static_cast<off_t>(sizeof(CodeMap))
+                && ftruncate(fd, sizeof(CodeMap)) < 0)) {
+        std::cerr << "Could not size code map " << path << '\n';
+        close(fd);
+        return;
+    }
+    void *mem = mmap(nullptr, sizeof(CodeMap), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        std::cerr << "Could not map code map " << path << '\n';
+        return;
+    }
+    map = static_cast<CodeMap*>(mem);
+
+    // A new map, or one left by an incompatible build, starts out empty
+    if(std::memcmp(map->magic, "LNESCODE", 8) != 0 || map->version != map_version
+            || map->abi_version != NES_AOT_ABI_VERSION || map->rom_hash != rom_hash) {
+        std::memset(map->hot, 0, sizeof(map->hot));
+        map->version = map_version;
+        map->abi_version = NES_AOT_ABI_VERSION;
+        map->rom_hash = rom_hash;
+        std::memcpy(map->magic, "LNESCODE", 8);
+    }
+}
+
+CodeCache::~CodeCache() {
+    if(map) munmap(map, sizeof(CodeMap));
+}
+
+std::string CodeCache::module_path(const std::string &source, const std::string &compiler) const {
+    uint64_t h = hash_bytes(reinterpret_cast<const uint8_t*>(source.data()), source.size());
+    h = hash_bytes(reinterpret_cast<const uint8_t*>(compiler.data()), compiler.size(), h);
+    char name[24];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(h));
+    return dir + "/" + prefix + "-" + name + ".so";
+}
+
+bool CodeCache::store(const std::string &compiled, const std::string &path) {
+    // Renaming is atomic, so other processes either see the whole module
+    // or none of it
+    if(rename(compiled.c_str(), path.c_str()) < 0) {
+        std::cerr << "Could not move " << compiled << " into the cache\n";
+        unlink(compiled.c_str());
+        return false;
+    }
+    // Processes still using the old modules keep them until they are done
+    DIR *d = opendir(dir.c_str());
+    if(!d) return true;
+    std::string mine = path.substr(path.find_last_of('/') + 1);
+    while(dirent *entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if(name != mine && name.compare(0, prefix.size() + 1, prefix + "-") == 0
+                && name.size() > 3 && name.compare(name.size() - 3, 3, ".so") == 0)
+            unlink((dir + "/" + name).c_str());
+    }
+    closedir(d);
+    return true;
+}
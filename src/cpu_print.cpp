@@ -0,0 +1,51 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <bitset>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "cpu_print.hpp"
+#include "disassembler.hpp"
+#include "emulator.hpp"
+
+using namespace nes;
+
+void nes::show_registers(const CpuState &state) {
+    // I use printf here because printing hexadecimal numbers the C++ way
+    // causes me physical pain
+    printf("PC: 0x%04X\n", state.pc);
+    printf("X: 0x%02X\n", state.x);
+    printf("Y: 0x%02X\n", state.y);
+    printf("A: 0x%02X\n", state.acc);
+    printf("S: 0x%02X\n", state.stack_ptr);
+    std::bitset<8> status_bits(state.status);
+    std::cout << "P: 0b" << status_bits << '\n';
+}
+
+void nes::show_opcode(const Emulator &nes_emu) {
+    std::string text = format(decode(nes_emu, nes_emu.get_cpu_state().pc));
+    printf("Next instruction to be executed: %s\n", text.c_str());
+}
+
+void nes::show_stack(const StackView &stack) {
+    std::cout << "[";
+    for(size_t i = 0; i < stack.size; ++i)
+        printf(i ? " 0x%02X" : "0x%02X", stack.data[i]);
+    std::cout << "]\n";
+}
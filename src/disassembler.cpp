@@ -0,0 +1,253 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "disassembler.hpp"
+#include "emulator.hpp"
+
+using namespace nes;
+
+// Opcodes that are special as far as control flow is concerned
+static const uint8_t op_brk = 0x00, op_jsr = 0x20, op_rti = 0x40, op_jmp = 0x4C,
+    op_rts = 0x60, op_jmp_ind = 0x6C;
+
+// The registers of the PPU, APU and controllers never hold code, and reading
+// some of them has side effects, so we never disassemble them
+static bool is_io(uint16_t addr) {
+    return addr >= 0x2000 && addr < 0x6000;
+}
+
+uint16_t Instruction::target() const {
+    if(info().mode == Addressing::Relative)
+        return addr + size + static_cast<int8_t>(operand[0]);
+    return value();
+}
+
+Instruction nes::decode(const Emulator &nes_emu, uint16_t addr) {
+    Instruction inst;
+    inst.addr = addr;
+    inst.opcode = nes_emu.peek(addr);
+    inst.size = 1 + operand_size(inst.info().mode);
+    for(int i = 1; i < inst.size; ++i)
+        inst.operand[i - 1] = nes_emu.peek(addr + i);
+    return inst;
+}
+
+std::string nes::format(const Instruction &inst) {
+    const OpcodeInfo &info = inst.info();
+    char text[32];
+    const char *mark = info.official ? "" : "*";
+    uint8_t byte = inst.operand[0];
+    uint16_t word = inst.value();
+    switch(info.mode) {
+        case Addressing::Null:
+        case Addressing::Implied:
+            snprintf(text, sizeof(text), "%s%s", mark, info.mnemonic); break;
+        case Addressing::Accumulator:
+            snprintf(text, sizeof(text), "%s%s A", mark, info.mnemonic); break;
+        case Addressing::Immediate:
+            snprintf(text, sizeof(text), "%s%s #$%02X", mark, info.mnemonic, byte); break;
+        case Addressing::ZeroPage:
+            snprintf(text, sizeof(text), "%s%s $%02X", mark, info.mnemonic, byte); break;
+        case Addressing::ZeroPage_x:
+            snprintf(text, sizeof(text), "%s%s $%02X,X", mark, info.mnemonic, byte); break;
+        case Addressing::ZeroPage_y:
+            snprintf(text, sizeof(text), "%s%s $%02X,Y", mark, info.mnemonic, byte); break;
+        case Addressing::Relative:
+            snprintf(text, sizeof(text), "%s%s $%04X", mark, info.mnemonic, inst.target()); break;
+        case Addressing::Absolute:
+            snprintf(text, sizeof(text), "%s%s $%04X", mark, info.mnemonic, word); break;
+        case Addressing::Absolute_x:
+            snprintf(text, sizeof(text), "%s%s $%04X,X", mark, info.mnemonic, word); break;
+        case Addressing::Absolute_y:
+            snprintf(text, sizeof(text), "%s%s $%04X,Y", mark, info.mnemonic, word); break;
+        case Addressing::Indirect:
+            snprintf(text, sizeof(text), "%s%s ($%04X)", mark, info.mnemonic, word); break;
+        case Addressing::Indirect_x:
+            snprintf(text, sizeof(text), "%s%s ($%02X,X)", mark, info.mnemonic, byte); break;
+        case Addressing::Indirect_y:
+            snprintf(text, sizeof(text), "%s%s ($%02X),Y", mark, info.mnemonic, byte); break;
+    }
+    return text;
+}
+
+void Disassembler::add_entry(uint16_t addr) {
+    entries.push_back(addr);
+    new_entries = true;
+}
+
+uint16_t Disassembler::refresh_banks() {
+    uint16_t changed = 0;
+    for(int i = 0; i < bank_count; ++i) {
+        uint16_t base = i * bank_size;
+        if(is_io(base)) continue;
+        uint64_t version = nes_emu.get_bank_version(base);
+        Bank &bank = banks[i];
+        if(bank.valid && bank.version == version) continue;
+        bank.valid = true;
+        bank.version = version;
+        bank.decoded.clear();
+        // Instructions at the very end of the previous bank have operands in
+        // this one, so they go as well
+        if(i > 0) {
+            auto &prev = banks[i - 1].decoded;
+            for(auto it = prev.begin(); it != prev.end();) {
+                if(it->second.addr + it->second.size > base) it = prev.erase(it);
+                else ++it;
+            }
+        }
+        changed |= 1 << i;
+    }
+    return changed;
+}
+
+const Instruction &Disassembler::decode_cached(uint16_t addr) {
+    auto &decoded = banks[addr / bank_size].decoded;
+    auto it = decoded.find(addr);
+    if(it == decoded.end())
+        it = decoded.emplace(addr, decode(nes_emu, addr)).first;
+    return it->second;
+}
+
+uint16_t Disassembler::untrace(uint16_t changed) {
+    // Whatever depends on a dropped bank goes too, and so on
+    uint16_t dropped = changed;
+    for(bool more = true; more;) {
+        more = false;
+        for(int i = 0; i < bank_count; ++i) {
+            if(dropped & 1 << i || !(banks[i].depends & dropped)) continue;
+            dropped |= 1 << i;
+            more = true;
+        }
+    }
+    for(int i = 0; i < bank_count; ++i) {
+        if(!(dropped & 1 << i)) continue;
+        Bank &bank = banks[i];
+        bank.depends = 0;
+        bank.visited.reset();
+        bank.listing.clear();
+        bank.exits.clear();
+    }
+    return dropped;
+}
+
+uint16_t Disassembler::trace(std::vector<uint16_t> pending) {
+    uint16_t grown = 0;
+    while(!pending.empty()) {
+        uint16_t addr = pending.back();
+        pending.pop_back();
+        int i = addr / bank_size;
+        Bank &bank = banks[i];
+        // Anywhere outside of this bank is left for the bank it's in, which
+        // then depends on this one for being reached
+        auto leave = [&](uint16_t target) {
+            int j = target / bank_size;
+            if(j != i && !is_io(target)) {
+                bank.exits.push_back(target);
+                banks[j].depends |= 1 << i;
+            }
+            pending.push_back(target);
+        };
+        // Keep going until the flow of control goes somewhere else for good
+        while(!is_io(addr) && !bank.visited[addr % bank_size]) {
+            const Instruction &inst = decode_cached(addr);
+            bank.visited[addr % bank_size] = true;
+            bank.listing.push_back(inst);
+            grown |= 1 << i;
+            // The operand may be in the next bank
+            uint16_t next = addr + inst.size;
+            bank.depends |= 1 << (static_cast<uint16_t>(next - 1) / bank_size);
+            uint8_t op = inst.opcode;
+            if(op == op_jmp) {
+                next = inst.target();
+            } else if(op == op_jmp_ind) {
+                // Our best guess is wherever the pointer points to right now,
+                // with the page wrapping bug of the original hardware
+                uint16_t ptr = inst.value();
+                uint16_t hi = (ptr & 0xFF00) | ((ptr + 1) & 0x00FF);
+                bank.depends |= 1 << (ptr / bank_size);
+                leave(nes_emu.peek(ptr) | nes_emu.peek(hi) << 8);
+                break;
+            } else if(op == op_rts || op == op_rti || op == op_brk
+                    || strcmp(inst.info().mnemonic, "JAM") == 0) {
+                break; // returns, interrupts and JAMs
+            } else if(op == op_jsr || inst.info().mode == Addressing::Relative) {
+                leave(inst.target());
+            }
+            if(next / bank_size != i) {
+                leave(next);
+                break;
+            }
+            addr = next;
+        }
+    }
+    // Only our own bank matters as far as dependencies go
+    for(int i = 0; i < bank_count; ++i)
+        banks[i].depends &= ~(1 << i);
+    return grown;
+}
+
+const std::vector<Instruction> &Disassembler::disassemble() {
+    uint16_t changed = refresh_banks();
+
+    // Interrupt vectors: NMI, reset and IRQ/BRK. Whatever the old ones
+    // reached would have to be found out and dropped, so when they change
+    // (which hardly ever happens), we simply start over
+    std::array<uint16_t, 3> current;
+    for(int i = 0; i < 3; ++i) {
+        uint16_t vector = 0xFFFA + 2 * i;
+        current[i] = nes_emu.peek(vector) | nes_emu.peek(vector + 1) << 8;
+    }
+    if(current != vectors) {
+        vectors = current;
+        changed = 0xFFFF;
+    }
+    if(!changed && !new_entries)
+        return listing;
+    new_entries = false;
+
+    // Start from every entry point (those already traced stop right away),
+    // and from wherever the banks we keep left off into the dropped ones
+    uint16_t dropped = untrace(changed);
+    std::vector<uint16_t> pending = entries;
+    pending.insert(pending.end(), vectors.begin(), vectors.end());
+    for(int i = 0; i < bank_count; ++i) {
+        if(dropped & 1 << i) continue;
+        for(uint16_t exit : banks[i].exits) {
+            int j = exit / bank_size;
+            if(!(dropped & 1 << j)) continue;
+            banks[j].depends |= 1 << i;
+            pending.push_back(exit);
+        }
+    }
+    uint16_t grown = trace(std::move(pending));
+
+    if(dropped || grown) {
+        listing.clear();
+        for(int i = 0; i < bank_count; ++i) {
+            Bank &bank = banks[i];
+            if(grown & 1 << i)
+                std::sort(bank.listing.begin(), bank.listing.end(),
+                        [](const Instruction &a, const Instruction &b) { return a.addr < b.addr; });
+            listing.insert(listing.end(), bank.listing.begin(), bank.listing.end());
+        }
+    }
+    return listing;
+}
@@ -16,38 +16,484 @@
    libre-nes. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cstdint>
+#include <fcntl.h>
 #include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "emulator.hpp"
+#include "hash.hpp"
 
 using namespace nes;
 
-void Emulator::load_prog(const std::vector<uint8_t> &prog, uint16_t inst_nr) {
-    instruction_nr = inst_nr;
+void Emulator::load_prog(const std::vector<uint8_t> &prog) {
     uint16_t addr = prog_start;
     for(auto byte : prog) {
         ram[addr++] = byte;
     }
+    touch_banks();
 }
 
-void Emulator::start() {
-    std::cout << "Initial state of the registers:\n";
-    cpu.show_registers();
-    for(uint16_t i = 0; i < instruction_nr; ++i) {
-        cpu.show_opcode();
-        cpu.single_step();
-        std::cout << "CPU registers after execution:\n";
-        cpu.show_registers();
-        std::cout << "Stack: ";
-        cpu.show_stack();
-        std::cout << '\n';
+bool Emulator::load_rom(const uint8_t *image, size_t size) {
+    if(!cart.load(image, size))
+        return false;
+    // Cheats and native code are made for a particular game (the cartridge
+    // drops its patches by itself)
+    freezes.clear();
+    tier.reset();
+    native.reset();
+    touch_banks();
+    // The reset vector now comes from the cartridge
+    reset();
+    frame_nr = 0;
+    return true;
+}
+
+void Emulator::reset() {
+    cpu.reset_state();
+    // The CPU's cycle count starts over, so the frame boundary has to as well
+    frame_end = cycles_per_frame;
+    // A reset is the way out of a halt
+    halt = HaltWatch();
+}
+
+void Emulator::set_halt_detection(bool enabled) {
+    halt_detection = enabled;
+    halt = HaltWatch();
+}
+
+void Emulator::check_halt() {
+    if(halt.halted) return;
+    CpuState state = cpu.get_state();
+    bool halted = cpu.is_jammed();
+    if(!halted) {
+        // Everything the rest of the run depends on, short of the input
+        uint8_t regs[] = { uint8_t(state.pc & 0xFF), uint8_t(state.pc >> 8), state.acc,
+            state.x, state.y, state.stack_ptr, state.status, strobe,
+            shift_reg[0], shift_reg[1] };
+        uint64_t hash = hash_bytes(regs, sizeof(regs), hash_ram());
+        if(!halt.watching || io_accesses != halt.io_accesses) {
+            halt.watching = true;
+            halt.io_accesses = io_accesses;
+            halt.checkpoint = hash;
+            halt.power = 1;
+            halt.length = 0;
+            return;
+        }
+        halted = hash == halt.checkpoint;
+        if(!halted && ++halt.length == halt.power) {
+            halt.checkpoint = hash;
+            halt.power *= 2;
+            halt.length = 0;
+        }
+    }
+    if(halted) {
+        halt.halted = true;
+        halt.pc = state.pc;
+        halt.frame = frame_nr;
+    }
+}
+
+bool Emulator::load_rom_file(const std::string &path) {
+    // The image is mapped rather than read into a buffer, so that the only
+    // copy made is the one the cartridge keeps of its ROM
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "Could not open " << path << '\n';
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size == 0) {
+        std::cerr << "Could not read " << path << '\n';
+        close(fd);
+        return false;
+    }
+    void *image = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(image == MAP_FAILED) {
+        std::cerr << "Could not map " << path << '\n';
+        return false;
+    }
+    bool ok = load_rom(static_cast<const uint8_t*>(image), st.st_size);
+    munmap(image, st.st_size);
+    return ok;
+}
+
+bool Emulator::load_native(const std::string &path) {
+    if(!cart.is_loaded()) {
+        std::cerr << "Native code needs a ROM to go with it\n";
+        return false;
+    }
+    if(!native) native = std::make_unique<NativeModule>();
+    if(!native->load(path, hash_prg_rom()))
+        return false;
+    // The module was compiled from the ROM as it is in the image
+    drop_patched_code();
+    init_native();
+    return true;
+}
+
+bool Emulator::enable_tiering(const std::string &compiler, const std::string &include_dir,
+        const std::string &cache_dir) {
+    if(!cart.is_loaded()) {
+        std::cerr << "Tiered execution needs a ROM to compile\n";
+        return false;
+    }
+    if(!native) native = std::make_unique<NativeModule>();
+    // Program ROM code is compiled once for every instance running the ROM
+    native->share(SharedCode::get(hash_prg_rom()));
+    drop_patched_code();
+    auto compiler_tier = std::make_unique<TieredCompiler>(*this, *native, compiler,
+            include_dir, cache_dir);
+    if(!compiler_tier->ok())
+        return false;
+    tier = std::move(compiler_tier);
+    init_native();
+    return true;
+}
+
+void Emulator::init_native() {
+    native_ctx.ram = ram.data();
+    native_ctx.side_effects = &side_effects;
+    native_ctx.ram_writes = &ram_writes;
+    native_ctx.bus = this;
+    native_ctx.read = [](void *bus, uint16_t addr) {
+        return static_cast<Emulator*>(bus)->read(addr);
+    };
+    native_ctx.write = [](void *bus, uint16_t addr, uint8_t data) {
+        static_cast<Emulator*>(bus)->write(addr, data);
+    };
+}
+
+void Emulator::code_changed(uint16_t first, uint16_t last) {
+    std::vector<uint16_t> dropped = native->invalidate(first, last);
+    if(tier && !dropped.empty()) tier->invalidated(dropped);
+}
+
+void Emulator::drop_patched_code() {
+    for(uint32_t page = 0x8000; page <= 0xFFFF; page += 0x100)
+        if(cart.is_patched(page)) code_changed(page, page + 0xFF);
+}
+
+uint64_t Emulator::hash_prg_rom() const {
+    const auto &rom = cart.get_prg_rom();
+    return hash_bytes(rom.data(), rom.size());
+}
+
+bool Emulator::add_cheat(const std::string &code) {
+    Cheat cheat;
+    if(!parse_cheat(code, cheat)) {
+        std::cerr << "Invalid cheat code: " << code << '\n';
+        return false;
+    }
+    if(!cheat.is_rom_patch()) {
+        freezes.push_back(cheat);
+        write(cheat.addr, cheat.value);
+        return true;
+    }
+    if(!cart.patch(cheat.addr, cheat.value, cheat.compare)) {
+        std::cerr << "Cheat code " << code << " does not apply to this ROM\n";
+        return false;
+    }
+    // The patched page may have been mapped in just now
+    cpu.remap();
+    touch_banks();
+    // Native code was compiled from the ROM as it was
+    if(native) code_changed(cheat.addr, cheat.addr);
+    return true;
+}
+
+void Emulator::clear_cheats() {
+    freezes.clear();
+    // Native code compiled from the patches is stale once they are gone,
+    // and shared code matches our ROM again
+    if(native) drop_patched_code();
+    cart.clear_patches();
+    cpu.remap();
+    touch_banks();
+    if(native) native->unshadow();
+}
+
+void Emulator::apply_freezes() {
+    for(const Cheat &cheat : freezes)
+        write(cheat.addr, cheat.value);
+}
+
+void Emulator::set_input_schedule(const uint8_t *schedule, size_t frames) {
+    this->schedule = frames > 0 ? schedule : nullptr;
+    schedule_frames = frames;
+    schedule_start = frame_nr;
+    if(this->schedule) apply_schedule();
+}
+
+void Emulator::apply_schedule() {
+    uint64_t index = frame_nr - schedule_start;
+    if(index >= schedule_frames) {
+        // The last input was already applied, and stays in effect
+        schedule = nullptr;
+        return;
+    }
+    input[0] = schedule[2 * index];
+    input[1] = schedule[2 * index + 1];
+}
+
+bool Emulator::export_shared(const std::string &name) {
+    shared = std::make_unique<SharedExport>(name);
+    if(!shared->is_open()) {
+        shared.reset();
+        return false;
+    }
+    // Readers shouldn't have to wait for the first frame to see something
+    shared->publish(*this);
+    return true;
+}
+
+bool Emulator::record_video(const std::string &path) {
+    video = std::make_unique<VideoRecorder>(path);
+    if(!video->is_ok()) {
+        video.reset();
+        return false;
+    }
+    // Palette index $0F is black, the usual backdrop color
+    picture.assign(VideoRecorder::width * VideoRecorder::height, 0x0F);
+    return true;
+}
+
+bool Emulator::record_audio(const std::string &path, uint32_t sample_rate) {
+    audio = std::make_unique<AudioRecorder>(path, sample_rate);
+    if(!audio->is_ok()) {
+        audio.reset();
+        return false;
+    }
+    this->sample_rate = sample_rate;
+    sample_phase = 0;
+    // All silence until there is an APU
+    sound.assign(cycles_per_frame * sample_rate / cpu_rate + 1, 0);
+    return true;
+}
+
+void Emulator::stop_recording() {
+    video.reset();
+    audio.reset();
+}
+
+void Emulator::record_frame() {
+    if(video) video->add_frame(picture.data());
+    if(audio) {
+        sample_phase += cycles_per_frame * sample_rate;
+        size_t samples = sample_phase / cpu_rate;
+        sample_phase %= cpu_rate;
+        audio->add_samples(sound.data(), samples);
     }
 }
 
+uint64_t Emulator::run_until(uint64_t cycle) {
+    // Deciding which loop to run once per call, rather than once per
+    // instruction, is what makes hooks free when there are none
+    if(!hooks) return run_loop<false>(cycle);
+    uint64_t count = run_loop<true>(cycle);
+    // The last hook may have removed itself, leaving the rest of the run
+    // with nothing to instrument
+    if(hooks || stop_requested) return count;
+    return count + run_loop<false>(cycle);
+}
+
+template<bool Hooked>
+uint64_t Emulator::run_loop(uint64_t cycle) {
+    uint64_t count = 0;
+    stop_requested = false;
+    // Whatever was watched before may have been changed from the outside
+    idle.active = false;
+    while(cpu.get_cycles() < cycle) {
+        uint16_t pc = cpu.get_pc();
+        // Native code runs a whole block in one go, so it is only used when
+        // the block is sure to end before the frame (or the run) does
+        const nes_aot_block_info *block = native && !Hooked ? native->find(pc) : nullptr;
+        if(block && cpu.get_cycles() + block->cycles < std::min(cycle, frame_end)) {
+            cpu.run_native(*block, native_ctx);
+            count += block->instructions;
+        } else {
+            if(tier && !Hooked) tier->count(pc);
+            if(step_impl<Hooked>()) ++count;
+        }
+        if constexpr(Hooked) {
+            // Skipping idle loops would skip their exec hooks too. Once the
+            // hooks are all gone, run_until takes over without them
+            if(stop_requested || !hooks) break;
+        } else {
+            // Jumping backwards (or in place) is how every loop comes around
+            if(cpu.get_pc() <= pc && idle_skipping)
+                count += skip_idle(cycle, count);
+        }
+    }
+    return count;
+}
+
+uint64_t Emulator::skip_idle(uint64_t cycle, uint64_t count) {
+    CpuState state = cpu.get_state();
+    const CpuState &start = idle.start;
+    bool same = idle.active && state.pc == start.pc && state.acc == start.acc
+        && state.x == start.x && state.y == start.y
+        && state.stack_ptr == start.stack_ptr && state.status == start.status
+        && side_effects == idle.side_effects;
+    if(!same) {
+        // Start watching the loop we are (maybe) in now
+        idle.active = true;
+        idle.start = state;
+        idle.side_effects = side_effects;
+        idle.count = count;
+        return 0;
+    }
+
+    // The only thing that can break the loop is the end of the frame (or of
+    // the run), so skip as many whole iterations as fit before it
+    idle.active = false;
+    uint64_t length = state.cycles - start.cycles;
+    uint64_t until = std::min(cycle, frame_end);
+    if(state.cycles >= until) return 0;
+    uint64_t iterations = (until - state.cycles) / length;
+    state.cycles += iterations * length;
+    cpu.set_state(state);
+    if(state.cycles >= frame_end) end_frame();
+    return iterations * (count - idle.count);
+}
+
+Hooks &Emulator::get_hooks() {
+    if(!hooks) hooks = std::make_unique<Hooks>();
+    return *hooks;
+}
+
+int Emulator::add_frame_hook(FrameHook hook) {
+    return get_hooks().add_frame(std::move(hook));
+}
+
+int Emulator::add_exec_hook(uint16_t pc, ExecHook hook) {
+    return get_hooks().add_exec(pc, std::move(hook));
+}
+
+int Emulator::add_write_hook(uint16_t addr, WriteHook hook) {
+    return get_hooks().add_write(addr, std::move(hook));
+}
+
+bool Emulator::remove_hook(int id) {
+    if(!hooks || !hooks->remove(id)) return false;
+    release_hooks();
+    return true;
+}
+
+// Save states start with a magic number and a version, which has to change
+// whenever the layout below does
+static const uint8_t state_magic[4] = { 'N', 'E', 'S', 'S' };
+static const uint8_t state_version = 2;
+
+const size_t Emulator::state_size = sizeof(state_magic) + 1 // header
+    + 2 + 5 + 8 // registers and cycle count
+    + 8 + 8     // frame number and end
+    + 2 + 2 + 1 // controllers, shift registers and strobe
+    + 0x0800    // RAM
+    + 0x2000;   // program RAM
+
+// Little endian helpers for save states, so that they don't depend on the
+// layout of our structures in memory
+static uint8_t *put(uint8_t *ptr, uint64_t value, int bytes) {
+    for(int i = 0; i < bytes; ++i)
+        *ptr++ = (value >> (8 * i)) & 0xFF;
+    return ptr;
+}
+
+static const uint8_t *get(const uint8_t *ptr, uint64_t &value, int bytes) {
+    value = 0;
+    for(int i = 0; i < bytes; ++i)
+        value |= uint64_t(*ptr++) << (8 * i);
+    return ptr;
+}
+
+void Emulator::save_state(uint8_t *buffer) const {
+    CpuState state = cpu.get_state();
+    uint8_t *ptr = std::copy(state_magic, state_magic + 4, buffer);
+    *ptr++ = state_version;
+    ptr = put(ptr, state.pc, 2);
+    *ptr++ = state.acc;
+    *ptr++ = state.x;
+    *ptr++ = state.y;
+    *ptr++ = state.stack_ptr;
+    *ptr++ = state.status;
+    ptr = put(ptr, state.cycles, 8);
+    ptr = put(ptr, frame_nr, 8);
+    ptr = put(ptr, frame_end, 8);
+    ptr = std::copy(input.begin(), input.end(), ptr);
+    ptr = std::copy(shift_reg.begin(), shift_reg.end(), ptr);
+    *ptr++ = strobe;
+    ptr = std::copy(ram.begin(), ram.end(), ptr);
+    const auto &prg_ram = cart.get_prg_ram();
+    std::copy(prg_ram.begin(), prg_ram.end(), ptr);
+}
+
+bool Emulator::load_state(const uint8_t *buffer) {
+    if(!std::equal(state_magic, state_magic + 4, buffer)
+            || buffer[4] != state_version)
+        return false;
+    const uint8_t *ptr = buffer + 5;
+    CpuState state;
+    uint64_t value;
+    ptr = get(ptr, value, 2);
+    state.pc = value;
+    state.acc = *ptr++;
+    state.x = *ptr++;
+    state.y = *ptr++;
+    state.stack_ptr = *ptr++;
+    state.status = *ptr++;
+    ptr = get(ptr, state.cycles, 8);
+    // Only the registers are saved, so whatever else the CPU had going on
+    // (being jammed, say) goes away with a reset first
+    cpu.reset_state();
+    cpu.set_state(state);
+    ptr = get(ptr, frame_nr, 8);
+    ptr = get(ptr, frame_end, 8);
+    std::copy(ptr, ptr + input.size(), input.begin());
+    ptr += input.size();
+    std::copy(ptr, ptr + shift_reg.size(), shift_reg.begin());
+    ptr += shift_reg.size();
+    strobe = *ptr++;
+    std::copy(ptr, ptr + ram.size(), ram.begin());
+    ptr += ram.size();
+    auto &prg_ram = cart.get_prg_ram();
+    std::copy(ptr, ptr + prg_ram.size(), prg_ram.begin());
+    // Which may have brought different code with it
+    touch_banks();
+    if(native) code_changed(0x6000, 0x7FFF);
+    // And the states seen so far are no longer where the run came from
+    halt = HaltWatch();
+    return true;
+}
+
+uint64_t Emulator::hash_ram() const {
+    uint64_t hash = hash_bytes(ram.data(), ram.size());
+    const auto &prg_ram = cart.get_prg_ram();
+    return hash_bytes(prg_ram.data(), prg_ram.size(), hash);
+}
+
 uint8_t Emulator::read(uint16_t addr) const {
     if(addr >= 0x0000 && addr <= 0x1FFF)
         // RAM is mirrored throught this range
         return ram[addr & 0x07FF];
+    else if(addr == 0x4016 || addr == 0x4017) {
+        // Controller ports: the next button comes out of bit 0. Official
+        // controllers shift in ones once all eight buttons are out, and the
+        // upper bits are open bus, which usually reads as $40
+        unsigned port = addr & 1;
+        ++side_effects;
+        ++io_accesses;
+        if(strobe) shift_reg[port] = input[port];
+        uint8_t bit = shift_reg[port] & 0x01;
+        shift_reg[port] = (shift_reg[port] >> 1) | 0x80;
+        return 0x40 | bit;
+    }
+    else if(addr >= 0x6000 && cart.is_loaded())
+        // The cartridge's program RAM and ROM live in this range
+        return cart.read(addr);
     else if(addr == 0xFFFC)
         // This address must contain the low byte of the program start
         return (prog_start & 0x00FF);
@@ -57,8 +503,57 @@ uint8_t Emulator::read(uint16_t addr) const {
     return 0;
 }
 
+const uint8_t *Emulator::code_page(uint16_t addr) const {
+    if(addr <= 0x1FFF)
+        return ram.data() + (addr & 0x0700);
+    if(addr >= 0x6000 && cart.is_loaded())
+        return cart.page(addr);
+    return nullptr;
+}
+
+uint8_t Emulator::peek(uint16_t addr) const {
+    if(addr == 0x4016 || addr == 0x4017) {
+        // What a read would return, minus the shifting
+        unsigned port = addr & 1;
+        return 0x40 | ((strobe ? input[port] : shift_reg[port]) & 0x01);
+    }
+    return read(addr);
+}
+
+void Emulator::poke(uint16_t addr, uint8_t data) {
+    if(addr <= 0x1FFF) {
+        ram[addr & 0x07FF] = data;
+        ++ram_writes;
+    } else if(addr >= 0x6000 && addr <= 0x7FFF && cart.is_loaded()) {
+        cart.write(addr, data);
+        ++bank_versions[addr >> 12];
+        if(native && native->covers(addr)) code_changed(addr, addr);
+    }
+}
+
 void Emulator::write(uint16_t addr, uint8_t data) {
-    if(addr >= 0x0000 && addr <= 0x1FFF)
+    ++side_effects;
+    if(addr >= 0x0000 && addr <= 0x1FFF) {
         // RAM is mirrored throught this range
         ram[addr & 0x07FF] = data;
+        ++ram_writes;
+    }
+    else if(addr == 0x4016) {
+        // Writing 1 and then 0 to the strobe bit latches the state of the
+        // buttons of both controllers into their shift registers
+        ++io_accesses;
+        strobe = data & 0x01;
+        if(strobe) shift_reg = input;
+    }
+    else if(addr >= 0x6000 && cart.is_loaded()) {
+        cart.write(addr, data);
+        if(addr <= 0x7FFF) ++bank_versions[addr >> 12];
+        // Code compiled from program RAM may have just been overwritten
+        if(native && native->covers(addr)) code_changed(addr, addr);
+    }
+    // Only a null check when no hooks are registered
+    if(hooks && hooks->has_write(addr)) {
+        hooks->fire_write(*this, addr, data);
+        release_hooks();
+    }
 }
@@ -0,0 +1,319 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "emulator.hpp"
+#include "gdb_stub.hpp"
+
+using namespace nes;
+
+static const char *hex_digits = "0123456789abcdef";
+
+static void append_hex(std::string &out, uint8_t byte) {
+    out += hex_digits[byte >> 4];
+    out += hex_digits[byte & 0x0F];
+}
+
+static int hex_value(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Parse a hex byte at the given position of a string, or -1 on failure
+static int parse_byte(const std::string &str, size_t pos) {
+    if(pos + 1 >= str.size()) return -1;
+    int hi = hex_value(str[pos]), lo = hex_value(str[pos + 1]);
+    if(hi < 0 || lo < 0) return -1;
+    return hi << 4 | lo;
+}
+
+bool GdbStub::serve(uint16_t port) {
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if(server < 0) {
+        std::cerr << "Could not create socket\n";
+        return false;
+    }
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // never expose it beyond
+    if(bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+            || listen(server, 1) < 0) {
+        std::cerr << "Could not listen on port " << port << '\n';
+        close(server);
+        return false;
+    }
+    std::cerr << "Waiting for GDB on 127.0.0.1:" << port << '\n';
+    conn = accept(server, nullptr, nullptr);
+    close(server);
+    if(conn < 0) {
+        std::cerr << "Could not accept connection\n";
+        return false;
+    }
+
+    std::string packet;
+    while(receive(packet) && handle(packet));
+
+    // Leave the emulator as we found it
+    for(const auto &[addr, id] : breakpoints) nes_emu.remove_hook(id);
+    for(const auto &[addr, id] : watchpoints) nes_emu.remove_hook(id);
+    breakpoints.clear();
+    watchpoints.clear();
+    close(conn);
+    conn = -1;
+    return true;
+}
+
+bool GdbStub::receive(std::string &packet) {
+    while(true) {
+        char c;
+        // Skip anything before the start of a packet, such as
+        // acknowledgements
+        do {
+            if(read(conn, &c, 1) != 1) return false;
+        } while(c != '$');
+        packet.clear();
+        uint8_t sum = 0;
+        while(true) {
+            if(read(conn, &c, 1) != 1) return false;
+            if(c == '#') break;
+            if(packet.size() >= packet_size) return false;
+            packet += c;
+            sum += c;
+        }
+        char checksum[2];
+        if(read(conn, checksum, 2) != 2) return false;
+        if(parse_byte(std::string(checksum, 2), 0) == sum)
+            return write(conn, "+", 1) == 1;
+        // Mangled on the way, so the debugger has to send it again
+        if(write(conn, "-", 1) != 1) return false;
+    }
+}
+
+void GdbStub::send(const std::string &packet) {
+    uint8_t sum = 0;
+    for(char c : packet) sum += c;
+    std::string out = "$" + packet + "#";
+    append_hex(out, sum);
+    if(write(conn, out.data(), out.size()) != (ssize_t) out.size())
+        std::cerr << "Could not send packet to GDB\n";
+}
+
+std::string GdbStub::read_registers() const {
+    CpuState state = nes_emu.get_cpu_state();
+    std::string out;
+    for(uint8_t reg : { state.acc, state.x, state.y, state.status, state.stack_ptr })
+        append_hex(out, reg);
+    append_hex(out, state.pc & 0xFF);
+    append_hex(out, state.pc >> 8);
+    return out;
+}
+
+bool GdbStub::write_registers(const std::string &hex) {
+    uint8_t regs[7];
+    if(hex.size() != 2 * sizeof(regs)) return false;
+    for(int i = 0; i < 7; ++i) {
+        int byte = parse_byte(hex, 2 * i);
+        if(byte < 0) return false;
+        regs[i] = byte;
+    }
+    CpuState state = nes_emu.get_cpu_state();
+    state.acc = regs[0];
+    state.x = regs[1];
+    state.y = regs[2];
+    state.status = regs[3];
+    state.stack_ptr = regs[4];
+    state.pc = regs[5] | regs[6] << 8;
+    nes_emu.set_cpu_state(state);
+    return true;
+}
+
+std::string GdbStub::read_memory(uint16_t addr, size_t len) const {
+    std::string out;
+    // A debugger looking at memory shouldn't change what the game sees
+    for(size_t i = 0; i < len; ++i)
+        append_hex(out, nes_emu.peek(addr + i));
+    return out;
+}
+
+void GdbStub::single_step() {
+    // Our breakpoints fire before their instruction runs, so the one under
+    // the PC has to be out of the way to make any progress
+    uint16_t pc = nes_emu.get_cpu_state().pc;
+    auto it = breakpoints.find(pc);
+    if(it != breakpoints.end()) nes_emu.remove_hook(it->second);
+    hit_watchpoint = -1;
+    nes_emu.step();
+    if(it != breakpoints.end())
+        it->second = nes_emu.add_exec_hook(pc, [](Emulator &emu, uint16_t) { emu.stop(); });
+}
+
+std::string GdbStub::resume() {
+    single_step();
+    if(hit_watchpoint >= 0 || breakpoints.count(nes_emu.get_cpu_state().pc))
+        return "S05";
+    while(true) {
+        // Full speed, a frame at a time: in between, check whether the
+        // debugger sent an interrupt (a lone 0x03 byte)
+        nes_emu.run_frame();
+        if(hit_watchpoint >= 0) {
+            char reply[32];
+            snprintf(reply, sizeof(reply), "T05watch:%04x;", hit_watchpoint);
+            return reply;
+        }
+        if(breakpoints.count(nes_emu.get_cpu_state().pc))
+            return "S05";
+        pollfd pfd { conn, POLLIN, 0 };
+        if(poll(&pfd, 1, 0) > 0) {
+            char c;
+            if(read(conn, &c, 1) != 1 || c == 0x03)
+                return "S02";
+        }
+    }
+}
+
+bool GdbStub::handle(const std::string &packet) {
+    char kind = packet.empty() ? '\0' : packet[0];
+    unsigned long addr = 0, len = 0;
+    switch(kind) {
+        case '?':
+            send("S05");
+            break;
+        case 'g':
+            send(read_registers());
+            break;
+        case 'G':
+            send(write_registers(packet.substr(1)) ? "OK" : "E01");
+            break;
+        case 'm':
+            if(sscanf(packet.c_str(), "m%lx,%lx", &addr, &len) != 2) {
+                send("E01");
+                break;
+            }
+            // Replies may be shorter than asked for, and two hex digits a
+            // byte is all that fits in a packet
+            len = std::min<unsigned long>(len, packet_size / 2);
+            send(read_memory(addr, len));
+            break;
+        case 'M': {
+            size_t colon = packet.find(':');
+            if(sscanf(packet.c_str(), "M%lx,%lx", &addr, &len) != 2
+                    || colon == std::string::npos) {
+                send("E01");
+                break;
+            }
+            if(packet.size() - colon - 1 != 2 * len) {
+                send("E01");
+                break;
+            }
+            std::vector<uint8_t> bytes;
+            for(size_t i = 0; i < len; ++i) {
+                int byte = parse_byte(packet, colon + 1 + 2 * i);
+                if(byte < 0) break;
+                bytes.push_back(byte);
+            }
+            if(bytes.size() != len) {
+                send("E01");
+                break;
+            }
+            // Like reads, writes from the debugger must not look like the
+            // game's own: no watchpoints firing, no controller strobes
+            for(size_t i = 0; i < len; ++i)
+                nes_emu.poke(addr + i, bytes[i]);
+            send("OK");
+            break;
+        }
+        case 's':
+            single_step();
+            send("S05");
+            break;
+        case 'c':
+            send(resume());
+            break;
+        case 'Z':
+        case 'z': {
+            unsigned type;
+            if(sscanf(packet.c_str() + 1, "%u,%lx", &type, &addr) != 2) {
+                send("E01");
+                break;
+            }
+            // Software and hardware breakpoints are one and the same here;
+            // of watchpoints, only write ones are supported
+            bool insert = kind == 'Z';
+            if(type == 0 || type == 1) {
+                auto it = breakpoints.find(addr);
+                if(insert && it == breakpoints.end()) {
+                    breakpoints[addr] = nes_emu.add_exec_hook(addr,
+                            [](Emulator &emu, uint16_t) { emu.stop(); });
+                } else if(!insert && it != breakpoints.end()) {
+                    nes_emu.remove_hook(it->second);
+                    breakpoints.erase(it);
+                }
+            } else if(type == 2) {
+                auto it = watchpoints.find(addr);
+                if(insert && it == watchpoints.end()) {
+                    watchpoints[addr] = nes_emu.add_write_hook(addr,
+                            [this](Emulator &emu, uint16_t addr, uint8_t) {
+                                hit_watchpoint = addr;
+                                emu.stop();
+                            });
+                } else if(!insert && it != watchpoints.end()) {
+                    nes_emu.remove_hook(it->second);
+                    watchpoints.erase(it);
+                }
+            } else {
+                send("");
+                break;
+            }
+            send("OK");
+            break;
+        }
+        case 'q':
+            if(packet.rfind("qSupported", 0) == 0) {
+                char reply[32];
+                snprintf(reply, sizeof(reply), "PacketSize=%zx", packet_size);
+                send(reply);
+            }
+            else if(packet == "qAttached") send("1");
+            else send("");
+            break;
+        case 'D':
+            send("OK");
+            return false;
+        case 'k':
+            return false;
+        default:
+            // An empty reply means "not supported"
+            send("");
+            break;
+    }
+    return true;
+}
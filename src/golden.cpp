@@ -0,0 +1,137 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "emulator.hpp"
+#include "movie.hpp"
+
+// Golden output regression checks: a known good run of a ROM is recorded as
+// a list of RAM hashes at chosen frames, optionally while replaying a movie,
+// and later runs are compared against it. This makes for a bit-exact check
+// that needs neither the RAM dumps nor any diffing. Golden files are plain
+// text, with one "frame hash" pair per line and '#' starting comments.
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " --rom FILE (--record FILE | --check FILE)\n"
+        "  --rom FILE          iNES image to run\n"
+        "  --record FILE       record a golden file\n"
+        "  --check FILE        compare against a golden file, running as many\n"
+        "                      frames as it covers\n"
+        "  --frames N          number of frames to record (default: 600)\n"
+        "  --every K           record a hash every K frames (default: 1)\n"
+        "  --movie FILE        replay the input in an FCEUX movie (.fm2)\n"
+        "Exits with 1 if any hash differs from the golden file.\n";
+}
+
+using Golden = std::vector<std::pair<uint64_t, uint64_t>>;
+
+static bool read_golden(const std::string &path, Golden &golden) {
+    std::ifstream file(path);
+    if(!file) return false;
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#') continue;
+        unsigned long long frame, hash;
+        if(sscanf(line.c_str(), "%llu %llx", &frame, &hash) != 2)
+            return false;
+        golden.emplace_back(frame, hash);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::string rom, record, check, movie_path;
+    uint64_t frames = 600, every = 1;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(arg == "--rom") rom = argv[++i];
+        else if(arg == "--record") record = argv[++i];
+        else if(arg == "--check") check = argv[++i];
+        else if(arg == "--frames") frames = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--movie") movie_path = argv[++i];
+        else if(arg == "--every") every = std::strtoull(argv[++i], nullptr, 10);
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(rom.empty() || record.empty() == check.empty() || every == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> movie;
+    if(!movie_path.empty() && !nes::read_fm2(movie_path, movie)) {
+        std::cerr << "Could not read movie " << movie_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    nes::Emulator nes_emu;
+    if(!nes_emu.load_rom_file(rom))
+        return EXIT_FAILURE;
+    nes_emu.set_input_schedule(movie.data(), movie.size() / 2);
+
+    if(!record.empty()) {
+        FILE *out = fopen(record.c_str(), "w");
+        if(out == nullptr) {
+            std::cerr << "Could not write " << record << '\n';
+            return EXIT_FAILURE;
+        }
+        fprintf(out, "# libre-nes golden RAM hashes for %s\n", rom.c_str());
+        for(uint64_t frame = 1; frame <= frames; ++frame) {
+            nes_emu.run_frame();
+            if(frame % every == 0)
+                fprintf(out, "%" PRIu64 " %016" PRIx64 "\n", frame, nes_emu.hash_ram());
+        }
+        fclose(out);
+        return EXIT_SUCCESS;
+    }
+
+    Golden golden;
+    if(!read_golden(check, golden)) {
+        std::cerr << "Could not read golden file " << check << '\n';
+        return EXIT_FAILURE;
+    }
+    uint64_t mismatches = 0;
+    for(const auto &[frame, expected] : golden) {
+        while(nes_emu.get_frame() < frame)
+            nes_emu.run_frame();
+        uint64_t hash = nes_emu.hash_ram();
+        if(hash != expected) {
+            if(mismatches == 0)
+                fprintf(stderr, "First mismatch at frame %" PRIu64 ": expected "
+                        "%016" PRIx64 ", got %016" PRIx64 "\n", frame, expected, hash);
+            ++mismatches;
+        }
+    }
+    printf("%" PRIu64 " of %zu hashes matched\n", golden.size() - mismatches,
+            golden.size());
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include "hash.hpp"
+
+using namespace nes;
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+static const uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t value, int amount) {
+    return (value << amount) | (value >> (64 - amount));
+}
+
+// Loads go through memcpy, which compiles down to a single (unaligned) load.
+// xxHash64 reads its input as little endian words, so that hashes (and the
+// golden files made of them) are the same on every host
+static inline uint64_t load64(const uint8_t *ptr) {
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static inline uint32_t load32(const uint8_t *ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+static inline uint64_t merge(uint64_t acc, uint64_t value) {
+    acc ^= hash_round(0, value);
+    return acc * prime1 + prime4;
+}
+
+uint64_t nes::hash_bytes(const uint8_t *data, size_t size, uint64_t seed) {
+    const uint8_t *end = data + size;
+    uint64_t hash;
+    if(size >= 32) {
+        // The bulk of the input is consumed 32 bytes at a time by four
+        // independent lanes, which keeps the multipliers busy in parallel
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        const uint8_t *limit = end - 32;
+        do {
+            v1 = hash_round(v1, load64(data));
+            v2 = hash_round(v2, load64(data + 8));
+            v3 = hash_round(v3, load64(data + 16));
+            v4 = hash_round(v4, load64(data + 24));
+            data += 32;
+        } while(data <= limit);
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = merge(hash, v1);
+        hash = merge(hash, v2);
+        hash = merge(hash, v3);
+        hash = merge(hash, v4);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += size;
+
+    // Whatever is left is less than 32 bytes long
+    for(; data + 8 <= end; data += 8) {
+        hash ^= hash_round(0, load64(data));
+        hash = rotl(hash, 27) * prime1 + prime4;
+    }
+    if(data + 4 <= end) {
+        hash ^= load32(data) * prime1;
+        hash = rotl(hash, 23) * prime2 + prime3;
+        data += 4;
+    }
+    for(; data < end; ++data) {
+        hash ^= *data * prime5;
+        hash = rotl(hash, 11) * prime1;
+    }
+
+    // Final avalanche, so that every input bit affects every output bit
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,111 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "emulator.hpp"
+#include "hooks.hpp"
+
+using namespace nes;
+
+int Hooks::add_frame(FrameHook hook) {
+    frame_hooks.push_back({ next_id, 0, std::move(hook) });
+    ++live;
+    return next_id++;
+}
+
+int Hooks::add_exec(uint16_t pc, ExecHook hook) {
+    exec_hooks.push_back({ next_id, pc, std::move(hook) });
+    exec_map[pc] = true;
+    ++live;
+    return next_id++;
+}
+
+int Hooks::add_write(uint16_t addr, WriteHook hook) {
+    write_hooks.push_back({ next_id, addr, std::move(hook) });
+    write_map[addr] = true;
+    ++live;
+    return next_id++;
+}
+
+// Mark the entry with the given id in a list as removed, clearing its address
+// from the map unless another entry still uses it
+template<typename List, typename Map>
+static bool remove_from(List &list, Map *map, int id) {
+    auto it = std::find_if(list.begin(), list.end(),
+            [id](const auto &entry) { return entry.id == id && !entry.removed; });
+    if(it == list.end()) return false;
+    it->removed = true;
+    if(map != nullptr) {
+        uint16_t addr = it->addr;
+        (*map)[addr] = std::any_of(list.begin(), list.end(), [addr](const auto &entry) {
+            return entry.addr == addr && !entry.removed;
+        });
+    }
+    return true;
+}
+
+bool Hooks::remove(int id) {
+    if(!remove_from(frame_hooks, (std::bitset<0x10000>*) nullptr, id)
+            && !remove_from(exec_hooks, &exec_map, id)
+            && !remove_from(write_hooks, &write_map, id))
+        return false;
+    --live;
+    // A hook may be removing itself, so its entry has to stay put until it
+    // returns
+    swept = false;
+    if(firing == 0) sweep();
+    return true;
+}
+
+template<typename List>
+static void erase_removed(List &list) {
+    list.erase(std::remove_if(list.begin(), list.end(),
+                [](const auto &entry) { return entry.removed; }), list.end());
+}
+
+void Hooks::sweep() {
+    erase_removed(frame_hooks);
+    erase_removed(exec_hooks);
+    erase_removed(write_hooks);
+    swept = true;
+}
+
+// Hooks added while firing land past the end taken at the start, so they only
+// get to run the next time around
+
+void Hooks::fire_frame(Emulator &nes_emu) {
+    Firing guard(*this);
+    for(size_t i = 0, n = frame_hooks.size(); i < n; ++i)
+        if(!frame_hooks[i].removed) frame_hooks[i].hook(nes_emu);
+}
+
+void Hooks::fire_exec(Emulator &nes_emu, uint16_t pc) {
+    Firing guard(*this);
+    for(size_t i = 0, n = exec_hooks.size(); i < n; ++i) {
+        auto &entry = exec_hooks[i];
+        if(entry.addr == pc && !entry.removed) entry.hook(nes_emu, pc);
+    }
+}
+
+void Hooks::fire_write(Emulator &nes_emu, uint16_t addr, uint8_t data) {
+    Firing guard(*this);
+    for(size_t i = 0, n = write_hooks.size(); i < n; ++i) {
+        auto &entry = write_hooks[i];
+        if(entry.addr == addr && !entry.removed) entry.hook(nes_emu, addr, data);
+    }
+}
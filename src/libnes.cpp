@@ -0,0 +1,196 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include "emulator.hpp"
+#include "libnes.h"
+
+// The opaque handle is just the emulator itself
+struct nes_emulator {
+    nes::Emulator emu;
+};
+
+// C callers have no way to deal with C++ exceptions (running out of memory,
+// say), so none may get past the entry points below. Those that can fail
+// report it through their return value instead; the others just give up
+template<typename Result, typename Body>
+static Result guarded(Result failure, Body body) noexcept {
+    try {
+        return body();
+    } catch(...) {
+        return failure;
+    }
+}
+
+template<typename Body>
+static void guarded(Body body) noexcept {
+    try {
+        body();
+    } catch(...) {
+    }
+}
+
+int nes_abi_version(void) {
+    return NES_ABI_VERSION;
+}
+
+nes_emulator *nes_create(void) {
+    return guarded<nes_emulator*>(nullptr, [] { return new nes_emulator; });
+}
+
+void nes_destroy(nes_emulator *emu) {
+    delete emu;
+}
+
+int nes_load_rom(nes_emulator *emu, const uint8_t *image, size_t size) {
+    return guarded(-1, [&] { return emu->emu.load_rom(image, size) ? 0 : -1; });
+}
+
+void nes_reset(nes_emulator *emu) {
+    guarded([&] { emu->emu.reset(); });
+}
+
+uint64_t nes_run_frame(nes_emulator *emu) {
+    return guarded<uint64_t>(0, [&] { return emu->emu.run_frame(); });
+}
+
+void nes_set_input(nes_emulator *emu, unsigned port, uint8_t buttons) {
+    emu->emu.set_input(port, buttons);
+}
+
+void nes_set_input_schedule(nes_emulator *emu, const uint8_t *schedule,
+        size_t frames) {
+    emu->emu.set_input_schedule(schedule, frames);
+}
+
+const uint8_t *nes_framebuffer(const nes_emulator *) {
+    return nullptr;
+}
+
+uint8_t *nes_ram(nes_emulator *emu) {
+    return emu->emu.get_ram().data();
+}
+
+void nes_get_cpu_state(const nes_emulator *emu, nes_cpu_state *state) {
+    nes::CpuState cpu = emu->emu.get_cpu_state();
+    state->pc = cpu.pc;
+    state->a = cpu.acc;
+    state->x = cpu.x;
+    state->y = cpu.y;
+    state->sp = cpu.stack_ptr;
+    state->p = cpu.status;
+    state->cycles = cpu.cycles;
+}
+
+void nes_set_cpu_state(nes_emulator *emu, const nes_cpu_state *state) {
+    nes::CpuState cpu;
+    cpu.pc = state->pc;
+    cpu.acc = state->a;
+    cpu.x = state->x;
+    cpu.y = state->y;
+    cpu.stack_ptr = state->sp;
+    cpu.status = state->p;
+    cpu.cycles = state->cycles;
+    emu->emu.set_cpu_state(cpu);
+}
+
+const uint8_t *nes_stack(const nes_emulator *emu, size_t *size) {
+    nes::StackView stack = emu->emu.get_stack();
+    *size = stack.size;
+    return stack.data;
+}
+
+int nes_add_cheat(nes_emulator *emu, const char *code) {
+    if(code == nullptr) return -1;
+    return guarded(-1, [&] { return emu->emu.add_cheat(code) ? 0 : -1; });
+}
+
+void nes_clear_cheats(nes_emulator *emu) {
+    guarded([&] { emu->emu.clear_cheats(); });
+}
+
+int nes_export_shared(nes_emulator *emu, const char *name) {
+    if(name == nullptr) return -1;
+    return guarded(-1, [&] { return emu->emu.export_shared(name) ? 0 : -1; });
+}
+
+int nes_record_video(nes_emulator *emu, const char *path) {
+    if(path == nullptr) return -1;
+    return guarded(-1, [&] { return emu->emu.record_video(path) ? 0 : -1; });
+}
+
+int nes_record_audio(nes_emulator *emu, const char *path, uint32_t sample_rate) {
+    if(path == nullptr || sample_rate == 0) return -1;
+    return guarded(-1, [&] {
+        return emu->emu.record_audio(path, sample_rate) ? 0 : -1;
+    });
+}
+
+void nes_stop_recording(nes_emulator *emu) {
+    guarded([&] { emu->emu.stop_recording(); });
+}
+
+int nes_add_frame_hook(nes_emulator *emu, nes_frame_hook hook, void *user) {
+    if(hook == nullptr) return -1;
+    return guarded(-1, [&] {
+        return emu->emu.add_frame_hook([=](nes::Emulator&) { hook(emu, user); });
+    });
+}
+
+int nes_add_exec_hook(nes_emulator *emu, uint16_t pc, nes_exec_hook hook,
+        void *user) {
+    if(hook == nullptr) return -1;
+    return guarded(-1, [&] {
+        return emu->emu.add_exec_hook(pc,
+                [=](nes::Emulator&, uint16_t pc) { hook(emu, user, pc); });
+    });
+}
+
+int nes_add_write_hook(nes_emulator *emu, uint16_t addr, nes_write_hook hook,
+        void *user) {
+    if(hook == nullptr) return -1;
+    return guarded(-1, [&] {
+        return emu->emu.add_write_hook(addr,
+                [=](nes::Emulator&, uint16_t addr, uint8_t data) {
+                    hook(emu, user, addr, data);
+                });
+    });
+}
+
+int nes_remove_hook(nes_emulator *emu, int id) {
+    return guarded(-1, [&] { return emu->emu.remove_hook(id) ? 0 : -1; });
+}
+
+void nes_stop(nes_emulator *emu) {
+    emu->emu.stop();
+}
+
+size_t nes_state_size(void) {
+    return nes::Emulator::state_size;
+}
+
+int nes_save_state(const nes_emulator *emu, uint8_t *buffer, size_t size) {
+    if(size < nes::Emulator::state_size) return -1;
+    emu->emu.save_state(buffer);
+    return 0;
+}
+
+int nes_load_state(nes_emulator *emu, const uint8_t *buffer, size_t size) {
+    if(size < nes::Emulator::state_size) return -1;
+    return guarded(-1, [&] { return emu->emu.load_state(buffer) ? 0 : -1; });
+}
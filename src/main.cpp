@@ -16,23 +16,190 @@
    libre-nes. If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <vector>
+#include <algorithm>
+#include <cinttypes>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
+#include "disassembler.hpp"
 #include "emulator.hpp"
+#include "gdb_stub.hpp"
+#include "movie.hpp"
+#include "recompiler.hpp"
+
+// Headless command line runner. It runs a ROM for a given number of frames or
+// cycles, optionally replaying a movie and dumping RAM at the end. Nothing is
+// printed while running, unless a trace is asked for (or the program halts,
+// with --stop-on-halt).
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " --rom FILE [options]\n"
+        "  --rom FILE              iNES image to run\n"
+        "  --frames N              run for N frames (default: 600)\n"
+        "  --cycles N              run for N CPU cycles instead\n"
+        "  --movie FILE            replay the input in an FCEUX movie (.fm2)\n"
+        "  --cheat CODE            apply a Game Genie (or raw AAAA:VV) cheat code;\n"
+        "                          may be given more than once\n"
+        "  --dump-ram FILE         write the contents of RAM to FILE at the end\n"
+        "  --screenshot-every N    save a screenshot every N frames\n"
+        "  --shm NAME              export RAM through a shared memory segment\n"
+        "  --record-video FILE     stream the picture to FILE (or - for stdout)\n"
+        "                          as YUV4MPEG2, blank until there is a PPU\n"
+        "  --record-audio FILE     stream the sound to FILE as 44.1kHz WAV,\n"
+        "                          silent until there is an APU; recording\n"
+        "                          never drops anything, so a slow consumer\n"
+        "                          slows emulation down to its pace\n"
+        "  --gdb PORT              wait for GDB on a loopback port instead of\n"
+        "                          running on our own\n"
+        "  --trace                 print the CPU state before every instruction\n"
+        "  --stop-on-halt          stop early if the program crashes, that is,\n"
+        "                          runs into a JAM opcode or gets stuck in a loop\n"
+        "  --backend NAME          CPU backend to use: interpreter (the default),\n"
+        "                          native, which needs --module, or tiered,\n"
+        "                          which compiles hot code on the fly\n"
+        "  --module FILE           native code module, from libre-nes-aot\n"
+        "  --cache DIR             keep compiled code in DIR across runs, for\n"
+        "                          the tiered backend\n";
+}
+
+static void trace(const nes::Emulator &nes_emu) {
+    nes::CpuState state = nes_emu.get_cpu_state();
+    nes::Instruction inst = nes::decode(nes_emu, state.pc);
+    char bytes[9];
+    snprintf(bytes, sizeof(bytes), inst.size == 1 ? "%02X" : inst.size == 2 ? "%02X %02X"
+            : "%02X %02X %02X", inst.opcode, inst.operand[0], inst.operand[1]);
+    printf("%04X  %-8s  %-13s  A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%" PRIu64 "\n",
+            state.pc, bytes, nes::format(inst).c_str(), state.acc, state.x,
+            state.y, state.status, state.stack_ptr, state.cycles);
+}
+
+int main(int argc, char *argv[]) {
+    std::string rom, movie_path, dump_ram, shm_name, module, cache, backend = "interpreter";
+    std::string video_path, audio_path;
+    uint64_t frames = 0, cycles = 0, screenshot_every = 0, gdb_port = 0;
+    std::vector<std::string> cheats;
+    bool tracing = false, stop_on_halt = false;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--trace") {
+            tracing = true;
+            continue;
+        }
+        if(arg == "--stop-on-halt") {
+            stop_on_halt = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(arg == "--rom") rom = argv[++i];
+        else if(arg == "--frames") frames = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--cycles") cycles = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--movie") movie_path = argv[++i];
+        else if(arg == "--cheat") cheats.push_back(argv[++i]);
+        else if(arg == "--dump-ram") dump_ram = argv[++i];
+        else if(arg == "--shm") shm_name = argv[++i];
+        else if(arg == "--record-video") video_path = argv[++i];
+        else if(arg == "--record-audio") audio_path = argv[++i];
+        else if(arg == "--gdb") gdb_port = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--screenshot-every")
+            screenshot_every = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--backend") backend = argv[++i];
+        else if(arg == "--module") module = argv[++i];
+        else if(arg == "--cache") cache = argv[++i];
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(rom.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(backend != "interpreter" && backend != "native" && backend != "tiered") {
+        std::cerr << "Unknown backend: " << backend << '\n';
+        return EXIT_FAILURE;
+    }
+    if((backend == "native") == module.empty()) {
+        std::cerr << "A native code module goes with the native backend\n";
+        return EXIT_FAILURE;
+    }
+    if(!cache.empty() && backend != "tiered") {
+        std::cerr << "A code cache goes with the tiered backend\n";
+        return EXIT_FAILURE;
+    }
+    if(screenshot_every != 0) {
+        std::cerr << "Screenshots need a PPU, which is not emulated yet\n";
+        return EXIT_FAILURE;
+    }
+    // Whichever limit is not given does not limit anything
+    if(frames == 0 && cycles == 0) frames = 600;
+    if(frames == 0) frames = UINT64_MAX;
+    if(cycles == 0) cycles = UINT64_MAX;
+
+    std::vector<uint8_t> movie;
+    if(!movie_path.empty() && !nes::read_fm2(movie_path, movie)) {
+        std::cerr << "Could not read movie " << movie_path << '\n';
+        return EXIT_FAILURE;
+    }
 
-int main() {
     nes::Emulator nes_emu;
-    std::vector<uint8_t> prog {
-        0xA9, 0x01, // lda #01
-        0xA0, 0x04, // ldy #04
-        0x11, 0x03, // ora ($03),Y
-    };
-    nes_emu.write(0x0003, 0x00);
-    nes_emu.write(0x0004, 0x05);
-    nes_emu.write(0x0504, 0x80);
-
-    nes_emu.load_prog(prog, 3);
-    nes_emu.start();
-    return 0;
+    if(!nes_emu.load_rom_file(rom))
+        return EXIT_FAILURE;
+    if(!module.empty() && !nes_emu.load_native(module))
+        return EXIT_FAILURE;
+    if(backend == "tiered" && !nes_emu.enable_tiering(nes::default_compiler(),
+                nes::default_include_dir(), cache))
+        return EXIT_FAILURE;
+    for(const std::string &cheat : cheats)
+        if(!nes_emu.add_cheat(cheat))
+            return EXIT_FAILURE;
+    if(!shm_name.empty() && !nes_emu.export_shared(shm_name))
+        return EXIT_FAILURE;
+    if(!video_path.empty() && !nes_emu.record_video(video_path))
+        return EXIT_FAILURE;
+    if(!audio_path.empty() && !nes_emu.record_audio(audio_path))
+        return EXIT_FAILURE;
+    nes_emu.set_input_schedule(movie.data(), movie.size() / 2);
+    nes_emu.set_halt_detection(stop_on_halt);
+
+    if(gdb_port != 0) {
+        // The debugger is in control, for as long as it stays connected
+        nes::GdbStub stub(nes_emu);
+        if(!stub.serve(gdb_port))
+            return EXIT_FAILURE;
+        frames = 0;
+    }
+
+    while(nes_emu.get_frame() < frames && nes_emu.get_cpu_state().cycles < cycles) {
+        uint64_t target = std::min(nes_emu.get_frame_end(), cycles);
+        if(!tracing) {
+            nes_emu.run_until(target);
+        } else {
+            while(nes_emu.get_cpu_state().cycles < target) {
+                trace(nes_emu);
+                nes_emu.step();
+            }
+        }
+        if(nes_emu.is_halted()) {
+            fprintf(stderr, "Halted at $%04X on frame %" PRIu64 "\n",
+                    nes_emu.get_halt_pc(), nes_emu.get_halt_frame());
+            break;
+        }
+    }
+
+    if(!dump_ram.empty()) {
+        std::ofstream file(dump_ram, std::ios::binary);
+        const auto &ram = nes_emu.get_ram();
+        if(!file.write(reinterpret_cast<const char*>(ram.data()), ram.size())) {
+            std::cerr << "Could not write " << dump_ram << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,54 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "movie.hpp"
+
+using namespace nes;
+
+bool nes::read_fm2(const std::string &path, std::vector<uint8_t> &schedule) {
+    // Every frame is a line like "|0|RLDUTSBA|RLDUTSBA||", where the first
+    // field holds commands (which we ignore) and the next ones hold the
+    // buttons of each port, in that order, with '.' or ' ' marking the ones
+    // not pressed. Anything else is metadata
+    std::ifstream file(path);
+    if(!file) return false;
+    schedule.clear();
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] != '|') continue;
+        uint8_t input[2] = {};
+        size_t pos = line.find('|', 1);
+        for(unsigned port = 0; port < 2 && pos != std::string::npos; ++port) {
+            size_t end = line.find('|', pos + 1);
+            std::string buttons = line.substr(pos + 1, end - pos - 1);
+            // In our representation, A is the lowest bit and Right the highest
+            for(size_t i = 0; i < buttons.size() && i < 8; ++i) {
+                if(buttons[i] != '.' && buttons[i] != ' ')
+                    input[port] |= 1 << (7 - i);
+            }
+            pos = end;
+        }
+        schedule.push_back(input[0]);
+        schedule.push_back(input[1]);
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <dlfcn.h>
+#include <iostream>
+#include "native_module.hpp"
+
+using namespace nes;
+
+NativeModule::~NativeModule() {
+    if(shared) shared->detach(reader);
+    for(void *handle : handles)
+        dlclose(handle);
+}
+
+bool NativeModule::load(const std::string &path, uint64_t rom_hash) {
+    void *lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(!lib) {
+        std::cerr << "Could not load " << path << ": " << dlerror() << '\n';
+        return false;
+    }
+    auto module = static_cast<const nes_aot_module*>(dlsym(lib, "nes_aot_module_info"));
+    if(!module || module->abi_version != NES_AOT_ABI_VERSION) {
+        std::cerr << path << " is not a compatible module\n";
+        dlclose(lib);
+        return false;
+    }
+    if(module->rom_hash != rom_hash) {
+        std::cerr << path << " was compiled from a different ROM\n";
+        dlclose(lib);
+        return false;
+    }
+
+    handles.push_back(lib);
+    for(uint32_t i = 0; i < module->block_count; ++i) {
+        const nes_aot_block_info &block = module->blocks[i];
+        if(block.addr < base || block.size == 0) continue;
+        table[block.addr - base] = &block;
+        for(uint32_t addr = block.addr; addr < block.addr + block.size && addr < 0x8000; ++addr)
+            ram_code[addr - base] = true;
+    }
+    return true;
+}
+
+void NativeModule::share(std::shared_ptr<SharedCode> code) {
+    if(shared) shared->detach(reader);
+    shared = std::move(code);
+    shadowed.reset();
+    if(shared) shared->attach(reader);
+}
+
+std::vector<uint16_t> NativeModule::invalidate(uint16_t first, uint16_t last) {
+    // Blocks are at most 256 instructions long, which bounds how far back
+    // one covering the range may start
+    std::vector<uint16_t> dropped;
+    if(last < base) return dropped;
+    uint32_t start = first >= base + 0x300 ? first - 0x300 : base;
+    for(uint32_t addr = start; addr <= last; ++addr) {
+        const nes_aot_block_info *&block = table[addr - base];
+        if(block && block->addr + block->size > first) {
+            dropped.push_back(block->addr);
+            block = nullptr;
+        }
+    }
+    for(uint32_t addr = std::max<uint32_t>(start, 0x8000); shared && addr <= last; ++addr) {
+        const nes_aot_block_info *block = shadowed[addr - 0x8000] ? nullptr : shared->find(addr);
+        if(block && block->addr + block->size > first) {
+            dropped.push_back(block->addr);
+            shadowed[addr - 0x8000] = true;
+        }
+    }
+    return dropped;
+}
@@ -16,8 +16,8 @@
    libre-nes. If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <bitset>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 
 #include "emulator.hpp"
@@ -25,31 +25,141 @@
 
 using namespace nes;
 
-Processor::Processor(Emulator &bus) : bus(bus) {
+template<typename Variant, typename Bus>
+BasicProcessor<Variant, Bus>::BasicProcessor(Bus &bus) : bus(bus) {
     // The initial value for the PC has to be fetched from 0xFFFC
     pc = bus.read(0xFFFC);
     pc |= bus.read(0xFFFD) << 8;
 }
 
-void Processor::reset_state() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::reset_state() {
     // Reset all of the registers
     x = 0;
     y = 0;
     acc = 0;
     status = 0;
     stack_ptr = 0xFF;
+    cycles = 0;
+    jammed = false;
     // The initial value for the PC has to be fetched from 0xFFFC
     pc = bus.read(0xFFFC);
     pc |= bus.read(0xFFFD) << 8;
     // Reset addressing mode to an initial, invalid state
     addr_mode = Addressing::Null;
+    // The cartridge may have changed too
+    remap();
 }
 
-void Processor::single_step() {
+template<typename Variant, typename Bus>
+CpuState BasicProcessor<Variant, Bus>::get_state() const {
+    CpuState state;
+    state.pc = pc;
+    state.acc = acc;
+    state.x = x;
+    state.y = y;
+    state.stack_ptr = stack_ptr;
+    state.status = status;
+    state.cycles = cycles;
+    return state;
+}
+
+template<typename Variant, typename Bus>
+StackView BasicProcessor<Variant, Bus>::get_stack() const {
+    // The stack pointer points at the next free position, so the values on
+    // the stack go from the one after it to the end of the stack page
+    StackView view;
+    view.data = bus.code_page(stack_base) + stack_ptr + 1;
+    view.size = 0xFF - stack_ptr;
+    return view;
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::set_state(const CpuState &state) {
+    pc = state.pc;
+    acc = state.acc;
+    x = state.x;
+    y = state.y;
+    stack_ptr = state.stack_ptr;
+    status = state.status;
+    cycles = state.cycles;
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::run_native(const nes_aot_block_info &block,
+        nes_aot_context &ctx) {
+    ctx.pc = pc;
+    ctx.a = acc;
+    ctx.x = x;
+    ctx.y = y;
+    ctx.sp = stack_ptr;
+    ctx.p = status;
+    block.run(&ctx);
+    pc = ctx.pc;
+    acc = ctx.a;
+    x = ctx.x;
+    y = ctx.y;
+    stack_ptr = ctx.sp;
+    status = ctx.p;
+    cycles += block.cycles;
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::set_fetch_window(bool enabled) {
+    window_enabled = enabled;
+    remap();
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::map_window() {
+    window_page = pc & 0xFF00;
+    window = window_enabled ? bus.code_page(pc) : nullptr;
+}
+
+template<typename Variant, typename Bus>
+inline uint8_t BasicProcessor<Variant, Bus>::fetch() {
+    if((pc & 0xFF00) != window_page) map_window();
+    uint8_t byte = window ? window[pc & 0x00FF] : bus.read(pc);
+    ++pc;
+    return byte;
+}
+
+template<typename Variant, typename Bus>
+inline uint16_t BasicProcessor<Variant, Bus>::fetch_word() {
+    // When both bytes are in the window, it's a single unaligned load
+    if((pc & 0xFF00) == window_page && window && (pc & 0x00FF) != 0x00FF) {
+        uint16_t word;
+        std::memcpy(&word, window + (pc & 0x00FF), 2);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = word << 8 | word >> 8;
+#endif
+        pc += 2;
+        return word;
+    }
+    uint16_t word = fetch();
+    return word | fetch() << 8;
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::single_step() {
     addr_mode = Addressing::Null;
-    uint8_t opcode = bus.read(pc++);
+    uint8_t opcode = fetch();
+    cycles += opcode_table[opcode].cycles;
     switch(opcode) {
-        // Testing stuff
+        // Every official opcode of the instructions implemented so far, plus
+        // the JAMs. Anything else is skipped over as a one byte no-op for now
+        case 0x01:
+            addr_mode = Addressing::Indirect_x;
+            inst_ora();
+            break;
+        case 0x02:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x05:
+            addr_mode = Addressing::ZeroPage;
+            inst_ora();
+            break;
         case 0x06:
             addr_mode = Addressing::ZeroPage;
             inst_asl();
@@ -58,110 +168,578 @@ void Processor::single_step() {
             addr_mode = Addressing::Implied;
             inst_php();
             break;
+        case 0x09:
+            addr_mode = Addressing::Immediate;
+            inst_ora();
+            break;
         case 0x0A:
             addr_mode = Addressing::Accumulator;
             inst_asl();
             break;
+        case 0x0D:
+            addr_mode = Addressing::Absolute;
+            inst_ora();
+            break;
         case 0x0E:
             addr_mode = Addressing::Absolute;
             inst_asl();
             break;
+        case 0x10:
+            addr_mode = Addressing::Relative;
+            inst_bpl();
+            break;
         case 0x11:
             addr_mode = Addressing::Indirect_y;
             inst_ora();
             break;
+        case 0x12:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x15:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_ora();
+            break;
+        case 0x16:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_asl();
+            break;
+        case 0x18:
+            addr_mode = Addressing::Implied;
+            inst_clc();
+            break;
+        case 0x19:
+            addr_mode = Addressing::Absolute_y;
+            inst_ora();
+            break;
+        case 0x1D:
+            addr_mode = Addressing::Absolute_x;
+            inst_ora();
+            break;
+        case 0x1E:
+            addr_mode = Addressing::Absolute_x;
+            inst_asl();
+            break;
+        case 0x20:
+            addr_mode = Addressing::Absolute;
+            inst_jsr();
+            break;
+        case 0x21:
+            addr_mode = Addressing::Indirect_x;
+            inst_and();
+            break;
+        case 0x22:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x24:
+            addr_mode = Addressing::ZeroPage;
+            inst_bit();
+            break;
+        case 0x25:
+            addr_mode = Addressing::ZeroPage;
+            inst_and();
+            break;
+        case 0x26:
+            addr_mode = Addressing::ZeroPage;
+            inst_rol();
+            break;
+        case 0x28:
+            addr_mode = Addressing::Implied;
+            inst_plp();
+            break;
         case 0x29:
             addr_mode = Addressing::Immediate;
             inst_and();
             break;
+        case 0x2A:
+            addr_mode = Addressing::Accumulator;
+            inst_rol();
+            break;
+        case 0x2C:
+            addr_mode = Addressing::Absolute;
+            inst_bit();
+            break;
+        case 0x2D:
+            addr_mode = Addressing::Absolute;
+            inst_and();
+            break;
+        case 0x2E:
+            addr_mode = Addressing::Absolute;
+            inst_rol();
+            break;
+        case 0x30:
+            addr_mode = Addressing::Relative;
+            inst_bmi();
+            break;
+        case 0x31:
+            addr_mode = Addressing::Indirect_y;
+            inst_and();
+            break;
+        case 0x32:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x35:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_and();
+            break;
+        case 0x36:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_rol();
+            break;
         case 0x38:
             addr_mode = Addressing::Implied;
             inst_sec();
             break;
+        case 0x39:
+            addr_mode = Addressing::Absolute_y;
+            inst_and();
+            break;
+        case 0x3D:
+            addr_mode = Addressing::Absolute_x;
+            inst_and();
+            break;
         case 0x3E:
             addr_mode = Addressing::Absolute_x;
             inst_rol();
             break;
+        case 0x41:
+            addr_mode = Addressing::Indirect_x;
+            inst_eor();
+            break;
+        case 0x42:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x45:
+            addr_mode = Addressing::ZeroPage;
+            inst_eor();
+            break;
+        case 0x46:
+            addr_mode = Addressing::ZeroPage;
+            inst_lsr();
+            break;
         case 0x48:
             addr_mode = Addressing::Implied;
             inst_pha();
             break;
+        case 0x49:
+            addr_mode = Addressing::Immediate;
+            inst_eor();
+            break;
+        case 0x4A:
+            addr_mode = Addressing::Accumulator;
+            inst_lsr();
+            break;
+        case 0x4C:
+            addr_mode = Addressing::Absolute;
+            inst_jmp();
+            break;
+        case 0x4D:
+            addr_mode = Addressing::Absolute;
+            inst_eor();
+            break;
+        case 0x4E:
+            addr_mode = Addressing::Absolute;
+            inst_lsr();
+            break;
+        case 0x50:
+            addr_mode = Addressing::Relative;
+            inst_bvc();
+            break;
+        case 0x51:
+            addr_mode = Addressing::Indirect_y;
+            inst_eor();
+            break;
+        case 0x52:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x55:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_eor();
+            break;
         case 0x56:
             addr_mode = Addressing::ZeroPage_x;
             inst_lsr();
             break;
+        case 0x58:
+            addr_mode = Addressing::Implied;
+            inst_cli();
+            break;
+        case 0x59:
+            addr_mode = Addressing::Absolute_y;
+            inst_eor();
+            break;
+        case 0x5D:
+            addr_mode = Addressing::Absolute_x;
+            inst_eor();
+            break;
+        case 0x5E:
+            addr_mode = Addressing::Absolute_x;
+            inst_lsr();
+            break;
+        case 0x60:
+            addr_mode = Addressing::Implied;
+            inst_rts();
+            break;
+        case 0x61:
+            addr_mode = Addressing::Indirect_x;
+            inst_adc();
+            break;
+        case 0x62:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x65:
+            addr_mode = Addressing::ZeroPage;
+            inst_adc();
+            break;
+        case 0x66:
+            addr_mode = Addressing::ZeroPage;
+            inst_ror();
+            break;
+        case 0x68:
+            addr_mode = Addressing::Implied;
+            inst_pla();
+            break;
+        case 0x69:
+            addr_mode = Addressing::Immediate;
+            inst_adc();
+            break;
+        case 0x6A:
+            addr_mode = Addressing::Accumulator;
+            inst_ror();
+            break;
         case 0x6C:
             addr_mode = Addressing::Indirect;
             inst_jmp();
             break;
+        case 0x6D:
+            addr_mode = Addressing::Absolute;
+            inst_adc();
+            break;
+        case 0x6E:
+            addr_mode = Addressing::Absolute;
+            inst_ror();
+            break;
+        case 0x70:
+            addr_mode = Addressing::Relative;
+            inst_bvs();
+            break;
+        case 0x71:
+            addr_mode = Addressing::Indirect_y;
+            inst_adc();
+            break;
+        case 0x72:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x75:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_adc();
+            break;
+        case 0x76:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_ror();
+            break;
+        case 0x78:
+            addr_mode = Addressing::Implied;
+            inst_sei();
+            break;
+        case 0x79:
+            addr_mode = Addressing::Absolute_y;
+            inst_adc();
+            break;
+        case 0x7D:
+            addr_mode = Addressing::Absolute_x;
+            inst_adc();
+            break;
+        case 0x7E:
+            addr_mode = Addressing::Absolute_x;
+            inst_ror();
+            break;
         case 0x81:
             addr_mode = Addressing::Indirect_x;
             inst_sta();
             break;
+        case 0x84:
+            addr_mode = Addressing::ZeroPage;
+            inst_sty();
+            break;
+        case 0x85:
+            addr_mode = Addressing::ZeroPage;
+            inst_sta();
+            break;
+        case 0x86:
+            addr_mode = Addressing::ZeroPage;
+            inst_stx();
+            break;
+        case 0x88:
+            addr_mode = Addressing::Implied;
+            inst_dey();
+            break;
+        case 0x8A:
+            addr_mode = Addressing::Implied;
+            inst_txa();
+            break;
+        case 0x8C:
+            addr_mode = Addressing::Absolute;
+            inst_sty();
+            break;
+        case 0x8D:
+            addr_mode = Addressing::Absolute;
+            inst_sta();
+            break;
+        case 0x8E:
+            addr_mode = Addressing::Absolute;
+            inst_stx();
+            break;
+        case 0x90:
+            addr_mode = Addressing::Relative;
+            inst_bcc();
+            break;
+        case 0x91:
+            addr_mode = Addressing::Indirect_y;
+            inst_sta();
+            break;
+        case 0x92:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0x94:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_sty();
+            break;
+        case 0x95:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_sta();
+            break;
+        case 0x96:
+            addr_mode = Addressing::ZeroPage_y;
+            inst_stx();
+            break;
+        case 0x98:
+            addr_mode = Addressing::Implied;
+            inst_tya();
+            break;
         case 0x99:
             addr_mode = Addressing::Absolute_y;
             inst_sta();
             break;
+        case 0x9A:
+            addr_mode = Addressing::Implied;
+            inst_txs();
+            break;
+        case 0x9D:
+            addr_mode = Addressing::Absolute_x;
+            inst_sta();
+            break;
         case 0xA0:
             addr_mode = Addressing::Immediate;
             inst_ldy();
             break;
+        case 0xA1:
+            addr_mode = Addressing::Indirect_x;
+            inst_lda();
+            break;
         case 0xA2:
             addr_mode = Addressing::Immediate;
             inst_ldx();
             break;
+        case 0xA4:
+            addr_mode = Addressing::ZeroPage;
+            inst_ldy();
+            break;
         case 0xA5:
             addr_mode = Addressing::ZeroPage;
             inst_lda();
             break;
+        case 0xA6:
+            addr_mode = Addressing::ZeroPage;
+            inst_ldx();
+            break;
+        case 0xA8:
+            addr_mode = Addressing::Implied;
+            inst_tay();
+            break;
         case 0xA9:
             addr_mode = Addressing::Immediate;
             inst_lda();
             break;
+        case 0xAA:
+            addr_mode = Addressing::Implied;
+            inst_tax();
+            break;
+        case 0xAC:
+            addr_mode = Addressing::Absolute;
+            inst_ldy();
+            break;
+        case 0xAD:
+            addr_mode = Addressing::Absolute;
+            inst_lda();
+            break;
+        case 0xAE:
+            addr_mode = Addressing::Absolute;
+            inst_ldx();
+            break;
+        case 0xB0:
+            addr_mode = Addressing::Relative;
+            inst_bcs();
+            break;
+        case 0xB1:
+            addr_mode = Addressing::Indirect_y;
+            inst_lda();
+            break;
+        case 0xB2:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0xB4:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_ldy();
+            break;
+        case 0xB5:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_lda();
+            break;
         case 0xB6:
             addr_mode = Addressing::ZeroPage_y;
             inst_ldx();
             break;
+        case 0xB8:
+            addr_mode = Addressing::Implied;
+            inst_clv();
+            break;
+        case 0xB9:
+            addr_mode = Addressing::Absolute_y;
+            inst_lda();
+            break;
+        case 0xBA:
+            addr_mode = Addressing::Implied;
+            inst_tsx();
+            break;
+        case 0xBC:
+            addr_mode = Addressing::Absolute_x;
+            inst_ldy();
+            break;
+        case 0xBD:
+            addr_mode = Addressing::Absolute_x;
+            inst_lda();
+            break;
+        case 0xBE:
+            addr_mode = Addressing::Absolute_y;
+            inst_ldx();
+            break;
+        case 0xC6:
+            addr_mode = Addressing::ZeroPage;
+            inst_dec();
+            break;
+        case 0xC8:
+            addr_mode = Addressing::Implied;
+            inst_iny();
+            break;
+        case 0xCA:
+            addr_mode = Addressing::Implied;
+            inst_dex();
+            break;
+        case 0xCE:
+            addr_mode = Addressing::Absolute;
+            inst_dec();
+            break;
+        case 0xD0:
+            addr_mode = Addressing::Relative;
+            inst_bne();
+            break;
+        case 0xD2:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0xD6:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_dec();
+            break;
+        case 0xD8:
+            addr_mode = Addressing::Implied;
+            inst_cld();
+            break;
+        case 0xDE:
+            addr_mode = Addressing::Absolute_x;
+            inst_dec();
+            break;
+        case 0xE1:
+            addr_mode = Addressing::Indirect_x;
+            inst_sbc();
+            break;
+        case 0xE5:
+            addr_mode = Addressing::ZeroPage;
+            inst_sbc();
+            break;
+        case 0xE6:
+            addr_mode = Addressing::ZeroPage;
+            inst_inc();
+            break;
+        case 0xE8:
+            addr_mode = Addressing::Implied;
+            inst_inx();
+            break;
+        case 0xE9:
+            addr_mode = Addressing::Immediate;
+            inst_sbc();
+            break;
+        case 0xEA:
+            // No operation
+            break;
+        case 0xED:
+            addr_mode = Addressing::Absolute;
+            inst_sbc();
+            break;
+        case 0xEE:
+            addr_mode = Addressing::Absolute;
+            inst_inc();
+            break;
         case 0xF0:
             addr_mode = Addressing::Relative;
             inst_beq();
             break;
+        case 0xF1:
+            addr_mode = Addressing::Indirect_y;
+            inst_sbc();
+            break;
+        case 0xF2:
+            addr_mode = Addressing::Implied;
+            inst_jam();
+            break;
+        case 0xF5:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_sbc();
+            break;
+        case 0xF6:
+            addr_mode = Addressing::ZeroPage_x;
+            inst_inc();
+            break;
+        case 0xF8:
+            addr_mode = Addressing::Implied;
+            inst_sed();
+            break;
+        case 0xF9:
+            addr_mode = Addressing::Absolute_y;
+            inst_sbc();
+            break;
+        case 0xFD:
+            addr_mode = Addressing::Absolute_x;
+            inst_sbc();
+            break;
+        case 0xFE:
+            addr_mode = Addressing::Absolute_x;
+            inst_inc();
+            break;
     }
 }
 
-void Processor::show_registers() const {
-    // I use printf here because printing hexadecimal numbers the C++ way
-    // causes me physical pain
-    printf("PC: 0x%04X\n", pc);
-    printf("X: 0x%02X\n", x);
-    printf("Y: 0x%02X\n", y);
-    printf("A: 0x%02X\n", acc);
-    printf("S: 0x%02X\n", stack_ptr);
-    std::bitset<8> status_bits(status);
-    std::cout << "P: 0b" << status_bits << '\n';
-}
-
-void Processor::show_opcode() const {
-    uint8_t op = bus.read(pc);
-    printf("Next opcode to be executed: 0x%02X\n", op);
-}
-
-void Processor::show_stack() const {
-    bool first = true;
-    uint16_t ptr = stack_base | stack_ptr;
-    std::cout << "[";
-    while(ptr < 0x01FF) {
-        if(first) {
-            printf("0x%02X", bus.read(++ptr));
-            first = false;
-        } else {
-            printf(" 0x%02X", bus.read(++ptr));
-        }
-    }
-    std::cout << "]\n";
-}
-
-void Processor::stack_push(uint8_t byte) {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::stack_push(uint8_t byte) {
     // NOTE remember, the stack is descending!
     // We have to decrement the stack pointer here
     uint16_t addr = stack_base | stack_ptr;
@@ -169,7 +747,8 @@ void Processor::stack_push(uint8_t byte) {
     --stack_ptr;
 }
 
-uint8_t Processor::stack_pull() {
+template<typename Variant, typename Bus>
+uint8_t BasicProcessor<Variant, Bus>::stack_pull() {
     // NOTE remember, the stack is descending!
     // We have to increment the stack pointer here
     ++stack_ptr;
@@ -177,18 +756,21 @@ uint8_t Processor::stack_pull() {
     return bus.read(addr);
 }
 
-uint8_t Processor::get_flag(Flag flag) const {
+template<typename Variant, typename Bus>
+uint8_t BasicProcessor<Variant, Bus>::get_flag(Flag flag) const {
     uint8_t f = static_cast<uint8_t>(flag);
     return status & f;
 }
 
-void Processor::set_flag(Flag flag, bool state) {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::set_flag(Flag flag, bool state) {
     uint8_t f = static_cast<uint8_t>(flag);
     if(state) status |= f;
     else status &= ~f;
 }
 
-uint16_t Processor::get_address() {
+template<typename Variant, typename Bus>
+uint16_t BasicProcessor<Variant, Bus>::get_address() {
     // Get an absolute address based on the addressing mode
     uint16_t address, ptr;
     switch(addr_mode) {
@@ -213,40 +795,39 @@ uint16_t Processor::get_address() {
 
         case Addressing::ZeroPage:
             // A zero page address is stored in the next byte
-            address = bus.read(pc++) & 0x00FF;
+            address = fetch() & 0x00FF;
             break;
         case Addressing::ZeroPage_x:
             // The zero page address in the next byte is summed with the
             // contents of the x register.
-            address = (bus.read(pc++) + x) & 0x00FF;
+            address = (fetch() + x) & 0x00FF;
             break;
         case Addressing::ZeroPage_y:
             // The zero page address in the next byte is summed with the
             // contents of the y register.
-            address = (bus.read(pc++) + y) & 0x00FF;
+            address = (fetch() + y) & 0x00FF;
             break;
 
         case Addressing::Relative:
             // This one is only used in branching instructions. The next byte
             // contains a signed, 8-bit jump offset, which should be correctly
             // converted to a 16-bit value and summed with the address of the
-            // instruction itself (which is PC minus 2 after reading the offset)
-            // to obtain the absolute address to jump to.
-            address = bus.read(pc++);
+            // next instruction (which is PC after reading the offset) to
+            // obtain the absolute address to jump to.
+            address = fetch();
 
             // To convert the jump offset to a 16-bit signed integer, we have
             // to check whether it is negative, which is indicated by the
             // value of the 7th bit. If it is, we have to set its high 8 bits
             // to 1s. This is enough for the address math to work out correctly.
             if(address & 0x80) address |= 0xFF00;
-            address += pc - 2;
+            address += pc;
             break;
 
         case Addressing::Absolute:
             // The following two bytes of the instruction are, in little endian
             // order, part of a 16-bit absolute address
-            address = bus.read(pc++);
-            address |= bus.read(pc++) << 8;
+            address = fetch_word();
             break;
         case Addressing::Absolute_x:
             // The following two bytes of the instruction are, in little endian
@@ -254,8 +835,7 @@ uint16_t Processor::get_address() {
             // with the contents of the x register. NOTE this may require an
             // aditional clock cycle if, after the addition with x, the address
             // crosses a page boundary
-            address = bus.read(pc++);
-            address |= bus.read(pc++) << 8;
+            address = fetch_word();
             address += x;
             break;
         case Addressing::Absolute_y:
@@ -264,34 +844,37 @@ uint16_t Processor::get_address() {
             // with the contents of the y register. NOTE this may require an
             // aditional clock cycle if, after the addition with y, the address
             // crosses a page boundary
-            address = bus.read(pc++);
-            address |= bus.read(pc++) << 8;
+            address = fetch_word();
             address += y;
             break;
 
         case Addressing::Indirect:
             // The following two bytes of the instruction are, in little endian
             // order, part of a 16-bit pointer to the real absolute address.
-            ptr = bus.read(pc++);
-            ptr |= bus.read(pc++) << 8;
+            ptr = fetch_word();
 
             // This addressing mode had a bug in the original hardware! When
             // adding 1 to the pointer would cross a page boundary, the high
             // byte of the target address is incorrectly fetched from the
             // beginning of the pointer's current page. For compatibility with
-            // the NES, this is a bug we have to reproduce
+            // the NES, this is a bug we have to reproduce. The 65C02 fixed
+            // it, and takes an extra cycle for its trouble
             address = bus.read(ptr);
-            if((ptr & 0x00FF) == 0x00FF)
+            if constexpr(Variant::cmos) {
+                address |= bus.read(ptr + 1) << 8;
+                ++cycles;
+            } else if((ptr & 0x00FF) == 0x00FF) {
                 address |= bus.read(ptr & 0xFF00) << 8;
-            else
+            } else {
                 address |= bus.read(ptr + 1) << 8;
+            }
             break;
 
         case Addressing::Indirect_x:
             // A zero page address is in the following byte. Summing it with
             // the contents of the x register (with zero page wrap around),
             // we get a zero page pointer to the real, 16-bit absolute address
-            ptr = bus.read(pc++);
+            ptr = fetch();
             ptr = (ptr + x) & 0x00FF;
             address = bus.read(ptr);
             address |= bus.read((ptr + 1) & 0x00FF) << 8;
@@ -302,7 +885,7 @@ uint16_t Processor::get_address() {
             // of the y register to give the final result. NOTE this may
             // require an extra clock cycle if, after addition with y, the
             // address crosses a page boundary
-            ptr = bus.read(pc++);
+            ptr = fetch();
             address = bus.read(ptr);
             address |= bus.read((ptr + 1) & 0x00FF) << 8;
             address += y;
@@ -311,7 +894,8 @@ uint16_t Processor::get_address() {
     return address;
 }
 
-uint8_t Processor::get_data(uint16_t *address) {
+template<typename Variant, typename Bus>
+uint8_t BasicProcessor<Variant, Bus>::get_data(uint16_t *address) {
     uint16_t addr;
     switch(addr_mode) {
         case Addressing::Null:
@@ -326,7 +910,7 @@ uint8_t Processor::get_data(uint16_t *address) {
             return acc;
         case Addressing::Immediate:
             // The data is the byte following the instruction
-            return bus.read(pc++);
+            return fetch();
         case Addressing::Relative:
             // It makes no sense to fetch data here, given that the only
             // instructions that use this mode are branching instructions,
@@ -345,40 +929,46 @@ uint8_t Processor::get_data(uint16_t *address) {
 
 // Load and store instructions:
 
-void Processor::inst_lda() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_lda() {
     // Load given data into the accumulator
     acc = get_data();
     set_flag(Flag::Zero, acc == 0);
     set_flag(Flag::Negative, acc & 0x80);
 }
 
-void Processor::inst_ldx() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_ldx() {
     // Load given data into the x register
     x = get_data();
     set_flag(Flag::Zero, x == 0);
     set_flag(Flag::Negative, x & 0x80);
 }
 
-void Processor::inst_ldy() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_ldy() {
     // Load given data into the y register
     y = get_data();
     set_flag(Flag::Zero, y == 0);
     set_flag(Flag::Negative, y & 0x80);
 }
 
-void Processor::inst_sta() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_sta() {
     // Store the contents of the accumulator into the given address
     uint16_t addr = get_address();
     bus.write(addr, acc);
 }
 
-void Processor::inst_stx() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_stx() {
     // Store the contens of the x register into the given address
     uint16_t addr = get_address();
     bus.write(addr, x);
 }
 
-void Processor::inst_sty() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_sty() {
     // Store the contens of the y register into the given address
     uint16_t addr = get_address();
     bus.write(addr, y);
@@ -386,28 +976,32 @@ void Processor::inst_sty() {
 
 // Register transfer instructions:
 
-void Processor::inst_tax() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_tax() {
     // Copy the accumulator into the x register
     x = acc;
     set_flag(Flag::Zero, x == 0);
     set_flag(Flag::Negative, x & 0x80);
 }
 
-void Processor::inst_tay() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_tay() {
     // Copy the accumulator into the y register
     y = acc;
     set_flag(Flag::Zero, y == 0);
     set_flag(Flag::Negative, y & 0x80);
 }
 
-void Processor::inst_txa() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_txa() {
     // Copy the x register into the accumulator
     acc = x;
     set_flag(Flag::Zero, acc == 0);
     set_flag(Flag::Negative, acc & 0x80);
 }
 
-void Processor::inst_tya() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_tya() {
     // Copy the y register into the accumulator
     acc = y;
     set_flag(Flag::Zero, acc == 0);
@@ -416,43 +1010,139 @@ void Processor::inst_tya() {
 
 // Stack instructions:
 
-void Processor::inst_tsx() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_tsx() {
     // Transfer stack pointer to the x register
     x = stack_ptr;
     set_flag(Flag::Zero, x == 0);
     set_flag(Flag::Negative, x & 0x80);
 }
 
-void Processor::inst_txs() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_txs() {
     // Transfer the contents of the x register to the stack pointer
     stack_ptr = x;
 }
 
-void Processor::inst_pha() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_pha() {
     // Push the value of the accumulator on the stack
     stack_push(acc);
 }
 
-void Processor::inst_php() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_php() {
     // Push the contents of the status register on the stack
     stack_push(status);
 }
 
-void Processor::inst_pla() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_pla() {
     // Pull a byte from the stack and put it into the accumulator
     acc = stack_pull();
     set_flag(Flag::Zero, acc == 0);
     set_flag(Flag::Negative, acc & 0x80);
 }
 
-void Processor::inst_plp() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_plp() {
     // Pull a byte from the stack and put it into the status register
     status = stack_pull();
 }
 
+// Arithmetic instructions:
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_adc() {
+    // Add the given data and the carry flag to the accumulator
+    uint8_t data = get_data();
+    if constexpr(Variant::decimal_mode) {
+        if(get_flag(Flag::Decimal)) {
+            add_decimal(data);
+            return;
+        }
+    }
+    add(data);
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_sbc() {
+    // Subtract the given data and the borrow (the carry flag, inverted) from
+    // the accumulator. In binary, that is the same as adding the complement
+    // of the data, which is exactly what the real hardware does
+    uint8_t data = get_data();
+    if constexpr(Variant::decimal_mode) {
+        if(get_flag(Flag::Decimal)) {
+            subtract_decimal(data);
+            return;
+        }
+    }
+    add(~data);
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::add(uint8_t data) {
+    unsigned sum = acc + data + (get_flag(Flag::Carry) ? 1 : 0);
+    // Overflow means the operands have the same sign, but the result doesn't
+    set_flag(Flag::Overflow, ~(acc ^ data) & (acc ^ sum) & 0x80);
+    set_flag(Flag::Carry, sum > 0xFF);
+    acc = sum & 0xFF;
+    set_flag(Flag::Zero, acc == 0);
+    set_flag(Flag::Negative, acc & 0x80);
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::add_decimal(uint8_t data) {
+    // Each nibble holds a decimal digit, so whenever a digit goes past 9 it
+    // has to be adjusted by 6 to carry into the next one
+    int carry = get_flag(Flag::Carry) ? 1 : 0;
+    int low = (acc & 0x0F) + (data & 0x0F) + carry;
+    if(low >= 0x0A) low = ((low + 0x06) & 0x0F) + 0x10;
+    int sum = (acc & 0xF0) + (data & 0xF0) + low;
+    // The NMOS chip takes N and V from the sum before the high digit gets
+    // adjusted, and Z from the binary sum. The 65C02 only fixed N and Z
+    set_flag(Flag::Overflow, ~(acc ^ data) & (acc ^ sum) & 0x80);
+    set_flag(Flag::Negative, sum & 0x80);
+    set_flag(Flag::Zero, ((acc + data + carry) & 0xFF) == 0);
+    if(sum >= 0xA0) sum += 0x60;
+    set_flag(Flag::Carry, sum > 0xFF);
+    acc = sum & 0xFF;
+    if constexpr(Variant::cmos) {
+        set_flag(Flag::Zero, acc == 0);
+        set_flag(Flag::Negative, acc & 0x80);
+        ++cycles;
+    }
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::subtract_decimal(uint8_t data) {
+    // Same as in addition, but digits that go below 0 are adjusted instead
+    int borrow = get_flag(Flag::Carry) ? 0 : 1;
+    int result;
+    if constexpr(Variant::cmos) {
+        result = acc - data - borrow;
+        if(result < 0) result -= 0x60;
+        if((acc & 0x0F) - (data & 0x0F) - borrow < 0) result -= 0x06;
+    } else {
+        int low = (acc & 0x0F) - (data & 0x0F) - borrow;
+        if(low < 0) low = ((low - 0x06) & 0x0F) - 0x10;
+        result = (acc & 0xF0) - (data & 0xF0) + low;
+        if(result < 0) result -= 0x60;
+    }
+    // Every flag is set just like in binary, except for N and Z on the 65C02
+    add(~data);
+    acc = result & 0xFF;
+    if constexpr(Variant::cmos) {
+        set_flag(Flag::Zero, acc == 0);
+        set_flag(Flag::Negative, acc & 0x80);
+        ++cycles;
+    }
+}
+
 // Logic instructions:
 
-void Processor::inst_and() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_and() {
     // Bitwise AND with the accumulator
     uint8_t data = get_data();
     acc &= data;
@@ -460,7 +1150,8 @@ void Processor::inst_and() {
     set_flag(Flag::Negative, acc & 0x80);
 }
 
-void Processor::inst_eor() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_eor() {
     // Bitwise XOR with the accumulator
     uint8_t data = get_data();
     acc ^= data;
@@ -468,7 +1159,8 @@ void Processor::inst_eor() {
     set_flag(Flag::Negative, acc & 0x80);
 }
 
-void Processor::inst_ora() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_ora() {
     // Bitwise OR with the accumulator
     uint8_t data = get_data();
     acc |= data;
@@ -476,7 +1168,8 @@ void Processor::inst_ora() {
     set_flag(Flag::Negative, acc & 0x80);
 }
 
-void Processor::inst_bit() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bit() {
     // Bitwise AND with the accumulator, but the result is not kept. It is
     // instead used to set the zero, negative and overflow flags
     uint8_t data = get_data();
@@ -488,7 +1181,8 @@ void Processor::inst_bit() {
 
 // Increment instructions:
 
-void Processor::inst_inc() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_inc() {
     // Increment the memory location at the given address
     uint16_t addr;
     uint8_t data = get_data(&addr);
@@ -498,14 +1192,16 @@ void Processor::inst_inc() {
     set_flag(Flag::Negative, data & 0x80);
 }
 
-void Processor::inst_inx() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_inx() {
     // Increment the x register
     ++x;
     set_flag(Flag::Zero, x == 0);
     set_flag(Flag::Negative, x & 0x80);
 }
 
-void Processor::inst_iny() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_iny() {
     // Increment the y register
     ++y;
     set_flag(Flag::Zero, y == 0);
@@ -514,7 +1210,8 @@ void Processor::inst_iny() {
 
 // Decrement instructions:
 
-void Processor::inst_dec() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_dec() {
     // Decrement the memory location at the given address
     uint16_t addr;
     uint8_t data = get_data(&addr);
@@ -524,14 +1221,16 @@ void Processor::inst_dec() {
     set_flag(Flag::Negative, data & 0x80);
 }
 
-void Processor::inst_dex() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_dex() {
     // Decrement the x register
     --x;
     set_flag(Flag::Zero, x == 0);
     set_flag(Flag::Negative, x & 0x80);
 }
 
-void Processor::inst_dey() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_dey() {
     // Decrement the y register
     --y;
     set_flag(Flag::Zero, y == 0);
@@ -540,7 +1239,8 @@ void Processor::inst_dey() {
 
 // Shift instructions:
 
-void Processor::inst_asl() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_asl() {
     // Arithmetic shift to the left of the memory location at the given address
     // or the accumulator, depending on the addressing mode
     uint16_t addr;
@@ -554,7 +1254,8 @@ void Processor::inst_asl() {
         acc = data;
 }
 
-void Processor::inst_lsr() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_lsr() {
     // Logical shift to the right of the memory location at the given address
     // or the accumulator, depending on the addressing mode
     uint16_t addr;
@@ -568,7 +1269,8 @@ void Processor::inst_lsr() {
         acc = data;
 }
 
-void Processor::inst_rol() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_rol() {
     // Rotate to the left the memory location at the given address or the
     // accumulator, depending on the addressing mode
     uint16_t addr;
@@ -586,7 +1288,8 @@ void Processor::inst_rol() {
         acc = data;
 }
 
-void Processor::inst_ror() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_ror() {
     // Rotate to the right the memory location at the given address or the
     // accumulator, depending on the addressing mode
     uint16_t addr;
@@ -606,12 +1309,14 @@ void Processor::inst_ror() {
 
 // Jump instructions:
 
-void Processor::inst_jmp() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_jmp() {
     // Unconditional jump to the given address
     pc = get_address();
 }
 
-void Processor::inst_jsr() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_jsr() {
     // Jump to subroutine: it's pretty similar to the unconditional jump, except
     // it pushes the address of the following instruction on the stack, so that
     // the program can return to it after the subroutine is done
@@ -621,7 +1326,8 @@ void Processor::inst_jsr() {
     pc = subroutine;
 }
 
-void Processor::inst_rts() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_rts() {
     // Return from subroutine: pops the stack for the address to return to
     pc = stack_pull() << 8;
     pc |= stack_pull();
@@ -629,58 +1335,77 @@ void Processor::inst_rts() {
 
 // Branch instructions:
 
-void Processor::inst_bcc() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::branch(bool taken) {
+    // The offset has to be fetched whether the branch is taken or not, so
+    // that the PC moves past it
+    uint16_t target = get_address();
+    if(taken) pc = target;
+}
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bcc() {
     // Branch if carry flag is clear
-    if(!get_flag(Flag::Carry)) {
-        pc = get_address();
-    }
+    branch(!get_flag(Flag::Carry));
 }
 
-void Processor::inst_bcs() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bcs() {
     // Branch if carry flag is set
-    if(get_flag(Flag::Carry)) {
-        pc = get_address();
-    }
+    branch(get_flag(Flag::Carry));
 }
 
-void Processor::inst_beq() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_beq() {
     // Branch if zero flag is set
-    if(get_flag(Flag::Zero)) {
-        pc = get_address();
-    }
+    branch(get_flag(Flag::Zero));
 }
 
-void Processor::inst_bmi() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bmi() {
     // Branch if negative flag is set
-    if(get_flag(Flag::Negative)) {
-        pc = get_address();
-    }
+    branch(get_flag(Flag::Negative));
 }
 
-void Processor::inst_bne() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bne() {
     // Branch if zero flag is clear
-    if(!get_flag(Flag::Zero)) {
-        pc = get_address();
-    }
+    branch(!get_flag(Flag::Zero));
 }
 
-void Processor::inst_bpl() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bpl() {
     // Branch if negative flag is clear
-    if(!get_flag(Flag::Negative)) {
-        pc = get_address();
-    }
+    branch(!get_flag(Flag::Negative));
 }
 
-void Processor::inst_bvc() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bvc() {
     // Branch if overflow flag is clear
-    if(!get_flag(Flag::Overflow)) {
-        pc = get_address();
-    }
+    branch(!get_flag(Flag::Overflow));
 }
 
-void Processor::inst_bvs() {
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_bvs() {
     // Branch if overflow flag is set
-    if(get_flag(Flag::Overflow)) {
-        pc = get_address();
+    branch(get_flag(Flag::Overflow));
+}
+
+// Illegal instructions:
+
+template<typename Variant, typename Bus>
+void BasicProcessor<Variant, Bus>::inst_jam() {
+    // The CPU gets stuck on the opcode for good. Going back to it each time
+    // keeps the clock ticking, so frames go on ending as usual
+    if constexpr(!Variant::cmos) {
+        --pc;
+        jammed = true;
     }
 }
+
+// Every variant is built here, so that none of the above has to live in the
+// header: the NES' own on the emulator's bus, and all of them on a flat one
+template class nes::BasicProcessor<Ricoh2A03, Emulator>;
+template class nes::BasicProcessor<Ricoh2A03, FlatBus>;
+template class nes::BasicProcessor<Nmos6502, FlatBus>;
+template class nes::BasicProcessor<Wdc65C02, FlatBus>;
@@ -0,0 +1,585 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <bitset>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "emulator.hpp"
+#include "recompiler.hpp"
+
+using namespace nes;
+
+// The instructions the interpreter implements, which are the only ones we
+// may recompile, since the two have to behave the same
+static const char *const supported[] = {
+    "LDA", "LDX", "LDY", "STA", "STX", "STY", "TAX", "TAY", "TXA", "TYA",
+    "TSX", "TXS", "PHA", "PHP", "PLA", "PLP", "AND", "EOR", "ORA", "BIT",
+    "INC", "INX", "INY", "DEC", "DEX", "DEY", "ASL", "LSR", "ROL", "ROR",
+    "JMP", "JSR", "RTS", "BCC", "BCS", "BEQ", "BMI", "BNE", "BPL", "BVC",
+    "BVS", "SEC", "SEI", "SED", "CLC", "CLI", "CLD", "CLV", "NOP",
+};
+
+// Opcodes with no relative addressing that move the PC around
+static const uint8_t op_jsr = 0x20, op_jmp = 0x4C, op_rts = 0x60, op_jmp_ind = 0x6C;
+
+bool nes::can_recompile(uint8_t opcode) {
+    const OpcodeInfo &info = opcode_table[opcode];
+    if(!info.official) return false;
+    for(const char *mnemonic : supported)
+        if(strcmp(info.mnemonic, mnemonic) == 0) return true;
+    return false;
+}
+
+// Whether an instruction ends a block no matter what comes after it
+static bool ends_block(const Instruction &inst) {
+    uint8_t op = inst.opcode;
+    return inst.info().mode == Addressing::Relative || op == op_jsr
+        || op == op_jmp || op == op_rts || op == op_jmp_ind;
+}
+
+// Where an indirect jump goes to, with the pointer as it is right now
+static uint16_t indirect_target(const Emulator &nes_emu, uint16_t ptr) {
+    uint16_t hi = (ptr & 0xFF00) | ((ptr + 1) & 0x00FF);
+    return nes_emu.peek(ptr) | nes_emu.peek(hi) << 8;
+}
+
+std::vector<CodeBlock> nes::find_blocks(const Emulator &nes_emu,
+        const std::vector<Instruction> &listing) {
+    // First, find every address a block has to start at
+    std::bitset<0x10000> leaders;
+    for(uint16_t vector : { 0xFFFA, 0xFFFC, 0xFFFE })
+        leaders[nes_emu.peek(vector) | nes_emu.peek(vector + 1) << 8] = true;
+    int prev_end = -1;
+    for(const Instruction &inst : listing) {
+        uint16_t next = inst.addr + inst.size;
+        if(inst.addr != prev_end) leaders[inst.addr] = true;
+        prev_end = inst.addr + inst.size;
+        if(inst.opcode == op_jmp_ind)
+            leaders[indirect_target(nes_emu, inst.value())] = true;
+        else if(ends_block(inst) && inst.opcode != op_rts)
+            leaders[inst.target()] = true;
+        if(ends_block(inst) || !can_recompile(inst.opcode))
+            leaders[next] = true;
+    }
+
+    // Then gather the instructions from each of them on
+    std::vector<CodeBlock> blocks;
+    for(size_t i = 0; i < listing.size(); ++i) {
+        const Instruction &first = listing[i];
+        if(first.addr < 0x8000 || !leaders[first.addr] || !can_recompile(first.opcode))
+            continue;
+        CodeBlock block;
+        block.addr = first.addr;
+        uint32_t end = first.addr;
+        for(size_t j = i; j < listing.size(); ++j) {
+            const Instruction &inst = listing[j];
+            if(inst.addr != end || (j > i && leaders[inst.addr])
+                    || !can_recompile(inst.opcode) || end + inst.size > 0x10000)
+                break;
+            block.instructions.push_back(inst);
+            end += inst.size;
+            // Keep the cycle count well within the limits of the ABI
+            if(ends_block(inst) || block.instructions.size() == 256) break;
+        }
+        if(!block.instructions.empty()) blocks.push_back(std::move(block));
+    }
+    return blocks;
+}
+
+// Code emission. Registers are kept in locals for the duration of a block,
+// and every instruction is translated into C++ which does exactly what the
+// corresponding method of the interpreter does, with two exceptions that
+// don't change the outcome. First, flags are only set when something in the
+// block reads them before they are set again (or the block ends), which is
+// most of the time not the case, as nearly every instruction sets them.
+// Second, whatever is known about the registers and flags, starting from
+// immediate loads, is folded into the code that follows.
+
+namespace {
+    std::string hex(unsigned value) {
+        char text[12];
+        snprintf(text, sizeof(text), "0x%04X", value);
+        return text;
+    }
+
+    // The flags the passes keep track of; the rest are always set
+    const uint8_t flag_c = 0x01, flag_z = 0x02, flag_v = 0x40, flag_n = 0x80;
+    const uint8_t all_flags = flag_c | flag_z | flag_v | flag_n;
+
+    // Flags an instruction reads
+    uint8_t flags_read(const Instruction &inst) {
+        std::string m = inst.info().mnemonic;
+        if(m == "PHP") return all_flags;
+        if(m == "ROL" || m == "ROR" || m == "BCC" || m == "BCS") return flag_c;
+        if(m == "BNE" || m == "BEQ") return flag_z;
+        if(m == "BVC" || m == "BVS") return flag_v;
+        if(m == "BPL" || m == "BMI") return flag_n;
+        return 0;
+    }
+
+    // Flags an instruction sets, no matter what
+    uint8_t flags_set(const Instruction &inst) {
+        std::string m = inst.info().mnemonic;
+        if(m == "PLP") return all_flags;
+        if(m == "BIT") return flag_n | flag_v | flag_z;
+        // Like the interpreter, shifts and rotations leave the zero flag be
+        if(m == "ASL" || m == "LSR" || m == "ROL" || m == "ROR") return flag_n | flag_c;
+        if(m == "SEC" || m == "CLC") return flag_c;
+        if(m == "CLV") return flag_v;
+        static const char *const zn[] = {
+            "LDA", "LDX", "LDY", "TAX", "TAY", "TXA", "TYA", "TSX", "PLA", "AND",
+            "EOR", "ORA", "INC", "INX", "INY", "DEC", "DEX", "DEY",
+        };
+        for(const char *mnemonic : zn)
+            if(m == mnemonic) return flag_n | flag_z;
+        return 0;
+    }
+
+    // Flags that are read after each instruction of a block, before being
+    // set again. Anything may read them once the block is done
+    std::vector<uint8_t> live_flags(const CodeBlock &block) {
+        std::vector<uint8_t> live(block.instructions.size());
+        uint8_t after = all_flags;
+        for(size_t i = live.size(); i-- > 0;) {
+            const Instruction &inst = block.instructions[i];
+            live[i] = after;
+            after = (after & ~flags_set(inst)) | flags_read(inst);
+        }
+        return live;
+    }
+
+    // What is known about the registers and flags at some point of a block.
+    // Registers are -1 when their value isn't known
+    struct Known {
+        int a = -1, x = -1, y = -1;
+        uint8_t flags = 0, values = 0;
+
+        void set(uint8_t mask, uint8_t bits) {
+            flags |= mask;
+            values = (values & ~mask) | (bits & mask);
+        }
+        void forget(uint8_t mask) { flags &= ~mask; }
+    };
+
+    // A register as an operand: its value, if it is known
+    std::string reg(const char *name, int value) {
+        return value < 0 ? name : hex(value);
+    }
+
+    // Set the given flags (a mask of N and Z) from a result, or whichever
+    // of them are live, as a statement to append
+    std::string nz(const std::string &v, int value, uint8_t mask, uint8_t live, Known &k) {
+        uint8_t out = mask & live;
+        if(value >= 0) {
+            uint8_t bits = (value == 0 ? flag_z : 0) | (value & flag_n);
+            k.set(mask, bits);
+            if(out == 0) return "";
+            return " p = (p & " + hex(~out & 0xFF) + ") | " + hex(bits & out) + ";";
+        }
+        k.forget(mask);
+        if(out == (flag_n | flag_z)) return " zn(p, " + v + ");";
+        if(out == flag_n) return " n(p, " + v + ");";
+        if(out == flag_z) return " z(p, " + v + ");";
+        return "";
+    }
+
+    // Where the operand of an instruction lives. If it is known to be in RAM,
+    // the index into it is given, so that it can be accessed directly
+    struct Operand {
+        std::string addr;
+        bool ram = false;
+    };
+
+    Operand operand(const Instruction &inst, const Known &k) {
+        Operand op;
+        std::string zp = hex(inst.operand[0]), abs = hex(inst.value());
+        std::string ptr = "c->ram[" + zp + "] | c->ram[(uint8_t)(" + zp + " + 1)] << 8";
+        switch(inst.info().mode) {
+            case Addressing::ZeroPage:
+                op.addr = zp;
+                op.ram = true;
+                break;
+            case Addressing::ZeroPage_x:
+            case Addressing::ZeroPage_y: {
+                bool by_x = inst.info().mode == Addressing::ZeroPage_x;
+                int index = by_x ? k.x : k.y;
+                op.addr = index >= 0 ? hex((inst.operand[0] + index) & 0xFF)
+                    : "(uint8_t)(" + zp + " + " + (by_x ? "x" : "y") + ")";
+                op.ram = true;
+                break;
+            }
+            case Addressing::Absolute:
+                op.ram = inst.value() < 0x2000;
+                op.addr = op.ram ? hex(inst.value() & 0x07FF) : abs;
+                break;
+            case Addressing::Absolute_x:
+            case Addressing::Absolute_y: {
+                bool by_x = inst.info().mode == Addressing::Absolute_x;
+                int index = by_x ? k.x : k.y;
+                if(index >= 0) {
+                    uint16_t ea = inst.value() + index;
+                    op.ram = ea < 0x2000;
+                    op.addr = hex(op.ram ? ea & 0x07FF : ea);
+                    break;
+                }
+                std::string name = by_x ? "x" : "y";
+                op.ram = inst.value() + 0xFF < 0x2000;
+                op.addr = op.ram ? "((" + abs + " + " + name + ") & 0x07FF)"
+                    : "(uint16_t)(" + abs + " + " + name + ")";
+                break;
+            }
+            case Addressing::Indirect_x:
+                if(k.x >= 0) {
+                    uint8_t at = inst.operand[0] + k.x;
+                    op.addr = "(uint16_t)(c->ram[" + hex(at) + "] | c->ram["
+                        + hex((at + 1) & 0xFF) + "] << 8)";
+                    break;
+                }
+                op.addr = "(uint16_t)(c->ram[(uint8_t)(" + zp + " + x)]"
+                    " | c->ram[(uint8_t)(" + zp + " + x + 1)] << 8)";
+                break;
+            case Addressing::Indirect_y:
+                op.addr = "(uint16_t)((" + ptr + ") + " + reg("y", k.y) + ")";
+                break;
+            default:
+                break;
+        }
+        return op;
+    }
+
+    // Whether an instruction writes through the bus rather than to RAM
+    bool writes_bus(const Instruction &inst) {
+        std::string m = inst.info().mnemonic;
+        bool stores = m == "STA" || m == "STX" || m == "STY" || m == "INC"
+            || m == "DEC" || m == "ASL" || m == "LSR" || m == "ROL" || m == "ROR";
+        return stores && inst.info().mode != Addressing::Accumulator
+            && !operand(inst, Known()).ram;
+    }
+
+    std::string read(const Operand &op, const std::string &addr) {
+        if(op.ram) return "c->ram[" + addr + "]";
+        return "c->read(c->bus, " + addr + ")";
+    }
+
+    std::string write(const Operand &op, const std::string &addr, const std::string &value) {
+        if(op.ram) return "c->ram[" + addr + "] = " + value + "; ++*c->side_effects; ++*c->ram_writes;";
+        return "c->write(c->bus, " + addr + ", " + value + ");";
+    }
+
+    // Fetch the data an instruction works on into v
+    std::string fetch(const Instruction &inst, const Known &k) {
+        if(inst.info().mode == Addressing::Immediate)
+            return "uint8_t v = " + hex(inst.operand[0]) + ";";
+        Operand op = operand(inst, k);
+        return "uint8_t v = " + read(op, op.addr) + ";";
+    }
+
+    // Read-modify-write instructions on memory
+    std::string modify(const Instruction &inst, const Known &k, const std::string &body) {
+        Operand op = operand(inst, k);
+        return "{ unsigned ea = " + op.addr + "; uint8_t v = " + read(op, "ea") + "; "
+            + body + " " + write(op, "ea", "v") + " }";
+    }
+
+    std::string store(const Instruction &inst, const Known &k, const std::string &value) {
+        Operand op = operand(inst, k);
+        return write(op, op.addr, value);
+    }
+
+    // Load a register from memory or an immediate
+    std::string load(const Instruction &inst, const char *name, int &value,
+            uint8_t live, Known &k) {
+        std::string name_s = name;
+        if(inst.info().mode == Addressing::Immediate) {
+            value = inst.operand[0];
+            return name_s + " = " + hex(value) + ";" + nz(name, value, flag_n | flag_z, live, k);
+        }
+        std::string get = fetch(inst, k);
+        value = -1;
+        return "{ " + get + " " + name_s + " = v;" + nz(name, -1, flag_n | flag_z, live, k) + " }";
+    }
+
+    // Copy a register into another, setting the flags unless it's the stack
+    std::string transfer(const char *to, int &to_value, const char *from, int from_value,
+            uint8_t live, Known &k) {
+        to_value = from_value;
+        return std::string(to) + " = " + reg(from, from_value) + ";"
+            + nz(to, from_value, flag_n | flag_z, live, k);
+    }
+
+    // Increment or decrement a register
+    std::string step(const char *name, int &value, int delta, uint8_t live, Known &k) {
+        std::string name_s = name;
+        if(value >= 0) {
+            value = (value + delta) & 0xFF;
+            return name_s + " = " + hex(value) + ";" + nz(name, value, flag_n | flag_z, live, k);
+        }
+        return (delta > 0 ? "++" : "--") + name_s + ";" + nz(name, -1, flag_n | flag_z, live, k);
+    }
+
+    // AND, EOR and ORA, folded when the accumulator and operand are known
+    std::string logic(const Instruction &inst, char op, uint8_t live, Known &k) {
+        bool immediate = inst.info().mode == Addressing::Immediate;
+        int v = immediate ? inst.operand[0] : -1;
+        int result = -1;
+        if(op == '&' && v == 0) result = 0;
+        else if(k.a >= 0 && v >= 0)
+            result = op == '&' ? k.a & v : op == '^' ? k.a ^ v : k.a | v;
+        if(result >= 0) {
+            k.a = result;
+            return "a = " + hex(result) + ";" + nz("a", result, flag_n | flag_z, live, k);
+        }
+        std::string get = fetch(inst, k);
+        k.a = -1;
+        return "{ " + get + " a " + op + "= v;" + nz("a", -1, flag_n | flag_z, live, k) + " }";
+    }
+
+    // Shifts and rotations, which set the carry to the bit shifted out
+    std::string shift(const Instruction &inst, uint8_t live, Known &k) {
+        std::string m = inst.info().mnemonic;
+        bool left = m == "ASL" || m == "ROL", rotate = m == "ROL" || m == "ROR";
+        uint8_t out = left ? 0x80 : 0x01;
+        if(inst.info().mode == Addressing::Accumulator && k.a >= 0
+                && (!rotate || (k.flags & flag_c))) {
+            uint8_t carry_in = rotate ? k.values & flag_c : 0;
+            uint8_t v = left ? (k.a << 1) | carry_in : (k.a >> 1) | carry_in << 7;
+            uint8_t bits = (k.a & out ? flag_c : 0) | (v & flag_n);
+            uint8_t set = (flag_n | flag_c) & live;
+            k.a = v;
+            k.set(flag_n | flag_c, bits);
+            std::string code = "a = " + hex(v) + ";";
+            if(set) code += " p = (p & " + hex(~set & 0xFF) + ") | " + hex(bits & set) + ";";
+            return code;
+        }
+
+        std::string body;
+        if(live & flag_c) body += std::string("uint8_t carry = v ") + (left ? ">> 7" : "& 0x01") + "; ";
+        body += left ? "v = (v << 1)" : "v = (v >> 1)";
+        if(rotate) body += left ? " | (p & 0x01)" : " | (p << 7)";
+        body += ";";
+        if(live & flag_c) body += " p = (p & 0xFE) | carry;";
+        body += nz("v", -1, flag_n, live, k);
+        k.forget(flag_c);
+        if(inst.info().mode != Addressing::Accumulator) return modify(inst, k, body);
+        k.a = -1;
+        return "{ uint8_t v = a; " + body + " a = v; }";
+    }
+
+    std::string branch(const Instruction &inst, uint8_t flag, bool set, const Known &k) {
+        if(k.flags & flag)
+            return "pc = " + hex((k.values & flag) == (set ? flag : 0)
+                    ? inst.target() : inst.addr + inst.size) + ";";
+        std::string cond = std::string(set ? "" : "!") + "(p & " + hex(flag) + ")";
+        return "pc = " + cond + " ? " + hex(inst.target()) + " : "
+            + hex(inst.addr + inst.size) + ";";
+    }
+
+    // Set or clear a flag the passes keep track of
+    std::string flag(uint8_t mask, bool set, uint8_t live, Known &k) {
+        k.set(mask, set ? mask : 0);
+        if(!(live & mask)) return "";
+        return set ? "p |= " + hex(mask) + ";" : "p &= ~" + hex(mask) + ";";
+    }
+
+    // Translate an instruction, given the flags that are live after it and
+    // what is known before it, which is updated to what is known after it.
+    // May come out empty, for instructions that don't do anything after all
+    std::string emit_instruction(const Instruction &inst, uint8_t live, Known &k) {
+        std::string m = inst.info().mnemonic;
+        uint16_t next = inst.addr + inst.size;
+        if(m == "LDA") return load(inst, "a", k.a, live, k);
+        if(m == "LDX") return load(inst, "x", k.x, live, k);
+        if(m == "LDY") return load(inst, "y", k.y, live, k);
+        if(m == "STA") return store(inst, k, reg("a", k.a));
+        if(m == "STX") return store(inst, k, reg("x", k.x));
+        if(m == "STY") return store(inst, k, reg("y", k.y));
+        if(m == "TAX") return transfer("x", k.x, "a", k.a, live, k);
+        if(m == "TAY") return transfer("y", k.y, "a", k.a, live, k);
+        if(m == "TXA") return transfer("a", k.a, "x", k.x, live, k);
+        if(m == "TYA") return transfer("a", k.a, "y", k.y, live, k);
+        if(m == "TSX") {
+            k.x = -1;
+            return "x = s;" + nz("x", -1, flag_n | flag_z, live, k);
+        }
+        if(m == "TXS") return "s = " + reg("x", k.x) + ";";
+        if(m == "PHA") return "push(c, s, " + reg("a", k.a) + ");";
+        if(m == "PHP") return "push(c, s, p);";
+        if(m == "PLA") {
+            k.a = -1;
+            return "a = pull(c, s);" + nz("a", -1, flag_n | flag_z, live, k);
+        }
+        if(m == "PLP") {
+            k.forget(all_flags);
+            return "p = pull(c, s);";
+        }
+        if(m == "AND") return logic(inst, '&', live, k);
+        if(m == "EOR") return logic(inst, '^', live, k);
+        if(m == "ORA") return logic(inst, '|', live, k);
+        if(m == "BIT") {
+            // The read itself stays, as it may have side effects
+            uint8_t set = (flag_n | flag_v | flag_z) & live;
+            k.forget(flag_n | flag_v | flag_z);
+            if(!set) return "{ " + fetch(inst, k) + " (void)v; }";
+            return "{ " + fetch(inst, k) + " v &= " + reg("a", k.a) + "; p = (p & "
+                + hex(~set & 0xFF) + ") | (((v == 0 ? 0x02 : 0) | (v & 0xC0)) & "
+                + hex(set) + "); }";
+        }
+        if(m == "INC") return modify(inst, k, "++v;" + nz("v", -1, flag_n | flag_z, live, k));
+        if(m == "DEC") return modify(inst, k, "--v;" + nz("v", -1, flag_n | flag_z, live, k));
+        if(m == "INX") return step("x", k.x, 1, live, k);
+        if(m == "INY") return step("y", k.y, 1, live, k);
+        if(m == "DEX") return step("x", k.x, -1, live, k);
+        if(m == "DEY") return step("y", k.y, -1, live, k);
+        if(m == "ASL" || m == "LSR" || m == "ROL" || m == "ROR") return shift(inst, live, k);
+        if(inst.opcode == op_jmp) return "pc = " + hex(inst.target()) + ";";
+        if(inst.opcode == op_jmp_ind) {
+            // With the page wrapping bug of the original hardware
+            uint16_t ptr = inst.value();
+            uint16_t hi = (ptr & 0xFF00) | ((ptr + 1) & 0x00FF);
+            Operand lo_op, hi_op;
+            lo_op.ram = ptr < 0x2000;
+            hi_op.ram = hi < 0x2000;
+            return "pc = " + read(lo_op, hex(lo_op.ram ? ptr & 0x07FF : ptr)) + " | "
+                + read(hi_op, hex(hi_op.ram ? hi & 0x07FF : hi)) + " << 8;";
+        }
+        if(m == "JSR")
+            return "push(c, s, " + hex(next & 0x00FF) + "); push(c, s, "
+                + hex(next >> 8) + "); pc = " + hex(inst.target()) + ";";
+        if(m == "RTS") return "pc = pull(c, s) << 8; pc |= pull(c, s);";
+        if(m == "BCC") return branch(inst, flag_c, false, k);
+        if(m == "BCS") return branch(inst, flag_c, true, k);
+        if(m == "BNE") return branch(inst, flag_z, false, k);
+        if(m == "BEQ") return branch(inst, flag_z, true, k);
+        if(m == "BVC") return branch(inst, flag_v, false, k);
+        if(m == "BVS") return branch(inst, flag_v, true, k);
+        if(m == "BPL") return branch(inst, flag_n, false, k);
+        if(m == "BMI") return branch(inst, flag_n, true, k);
+        if(m == "SEC") return flag(flag_c, true, live, k);
+        if(m == "CLC") return flag(flag_c, false, live, k);
+        if(m == "CLV") return flag(flag_v, false, live, k);
+        if(m == "SEI") return "p |= 0x04;";
+        if(m == "SED") return "p |= 0x08;";
+        if(m == "CLI") return "p &= ~0x04;";
+        if(m == "CLD") return "p &= ~0x08;";
+        return ""; // NOP
+    }
+}
+
+CodeBlock nes::decode_block(const Emulator &nes_emu, uint16_t addr) {
+    CodeBlock block;
+    block.addr = addr;
+    uint32_t pos = addr;
+    while(pos >= 0x6000 && block.instructions.size() < 256) {
+        Instruction inst = decode(nes_emu, pos);
+        if(!can_recompile(inst.opcode) || pos + inst.size > 0x10000) break;
+        if(pos < 0x8000 && writes_bus(inst)) break;
+        block.instructions.push_back(inst);
+        pos += inst.size;
+        if(ends_block(inst)) break;
+    }
+    return block;
+}
+
+// Helpers shared by every block of a module
+static const char prelude[] =
+    "#include <stdint.h>\n"
+    "#include \"aot_abi.h\"\n"
+    "\n"
+    "static inline void zn(uint8_t &p, uint8_t v) {\n"
+    "    p = (p & 0x7D) | (v == 0 ? 0x02 : 0) | (v & 0x80);\n"
+    "}\n"
+    "static inline void n(uint8_t &p, uint8_t v) {\n"
+    "    p = (p & 0x7F) | (v & 0x80);\n"
+    "}\n"
+    "static inline void z(uint8_t &p, uint8_t v) {\n"
+    "    p = (p & 0xFD) | (v == 0 ? 0x02 : 0);\n"
+    "}\n"
+    "static inline void push(nes_aot_context *c, uint8_t &s, uint8_t v) {\n"
+    "    c->ram[0x0100 | s--] = v;\n"
+    "    ++*c->side_effects;\n"
+    "    ++*c->ram_writes;\n"
+    "}\n"
+    "static inline uint8_t pull(nes_aot_context *c, uint8_t &s) {\n"
+    "    return c->ram[0x0100 | ++s];\n"
+    "}\n";
+
+std::string nes::emit_module(const std::vector<CodeBlock> &blocks, uint64_t rom_hash) {
+    std::string out = "// Generated by libre-nes-aot, do not edit\n";
+    out += prelude;
+    for(const CodeBlock &block : blocks) {
+        out += "\nstatic void block_" + hex(block.addr) + "(nes_aot_context *c) {\n"
+            "    uint8_t a = c->a, x = c->x, y = c->y, s = c->sp, p = c->p;\n"
+            "    uint16_t pc;\n";
+        std::vector<uint8_t> live = live_flags(block);
+        Known known;
+        for(size_t i = 0; i < block.instructions.size(); ++i) {
+            const Instruction &inst = block.instructions[i];
+            std::string code = emit_instruction(inst, live[i], known);
+            out += "    " + (code.empty() ? "" : code + " ") + "// " + hex(inst.addr)
+                + ": " + format(inst) + "\n";
+        }
+        const Instruction &last = block.instructions.back();
+        if(!ends_block(last))
+            out += "    pc = " + hex(last.addr + last.size) + ";\n";
+        out += "    c->pc = pc; c->a = a; c->x = x; c->y = y; c->sp = s; c->p = p;\n}\n";
+    }
+
+    // An empty array is not valid C++, so there is always a terminator
+    out += "\nstatic const nes_aot_block_info blocks[] = {\n";
+    for(const CodeBlock &block : blocks) {
+        const Instruction &last = block.instructions.back();
+        unsigned cycles = 0;
+        for(const Instruction &inst : block.instructions)
+            cycles += inst.info().cycles;
+        char line[96];
+        snprintf(line, sizeof(line), "    { 0x%04X, %u, %zu, %u, block_0x%04X },\n",
+                block.addr, last.addr + last.size - block.addr,
+                block.instructions.size(), cycles, block.addr);
+        out += line;
+    }
+    out += "    { 0, 0, 0, 0, 0 },\n";
+    char info[160];
+    snprintf(info, sizeof(info), "};\n\nextern \"C\" const nes_aot_module nes_aot_module_info = {\n"
+            "    NES_AOT_ABI_VERSION, 0x%016" PRIX64 "ULL, %zu, blocks\n};\n",
+            rom_hash, blocks.size());
+    out += info;
+    return out;
+}
+
+bool nes::compile_module(const std::string &source_path, const std::string &output,
+        const std::string &compiler, const std::string &include_dir) {
+    std::string command = compiler + " -O2 -shared -fPIC -I'" + include_dir + "' -o '"
+        + output + "' '" + source_path + "'";
+    return std::system(command.c_str()) == 0;
+}
+
+std::string nes::default_compiler() {
+    const char *cxx = std::getenv("CXX");
+    return cxx && *cxx ? cxx : "c++";
+}
+
+// The build system tells us where the headers are in the source tree
+#ifndef NES_INCLUDE_DIR
+#define NES_INCLUDE_DIR "include"
+#endif
+
+std::string nes::default_include_dir() {
+    return NES_INCLUDE_DIR;
+}
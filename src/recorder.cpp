@@ -0,0 +1,292 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "recorder.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace nes;
+
+AsyncWriter::AsyncWriter(const std::string &path, size_t max_pending)
+        : max_pending(max_pending) {
+    file = path == "-" ? stdout : fopen(path.c_str(), "wb");
+    if(file == nullptr) {
+        std::cerr << "Could not open " << path << '\n';
+        return;
+    }
+    worker = std::thread(&AsyncWriter::run, this);
+}
+
+AsyncWriter::~AsyncWriter() {
+    if(file == nullptr) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    not_empty.notify_one();
+    worker.join();
+    if(file == stdout) fflush(file);
+    else fclose(file);
+}
+
+std::vector<uint8_t> AsyncWriter::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(spare.empty()) return {};
+    std::vector<uint8_t> chunk = std::move(spare.back());
+    spare.pop_back();
+    chunk.clear();
+    return chunk;
+}
+
+void AsyncWriter::submit(std::vector<uint8_t> &&chunk) {
+    if(file == nullptr) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this] { return pending.size() < max_pending; });
+    pending.push_back(std::move(chunk));
+    lock.unlock();
+    not_empty.notify_one();
+}
+
+void AsyncWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        not_empty.wait(lock, [this] { return done || !pending.empty(); });
+        if(pending.empty()) return; // done, and nothing left to write
+        std::vector<uint8_t> chunk = std::move(pending.front());
+        pending.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        if(!failed && fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size())
+            failed = true;
+        lock.lock();
+        spare.push_back(std::move(chunk));
+    }
+}
+
+// The 2C02's palette, as RGB. Only the lower 6 bits of a palette index are
+// used to look it up; the emphasis bits are ignored
+static const uint32_t nes_palette[64] = {
+    0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+    0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+    0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+    0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+    0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+    0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+    0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+    0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+};
+
+// Lookup tables from palette index to each plane (Y, Cb and Cr, in that
+// order), indexed by the full byte so that the scalar loop needs no masking.
+// They are computed once, with the BT.601 limited range coefficients that
+// Y4M consumers assume by default
+struct PlaneTables {
+    std::array<uint8_t, 256> planes[3];
+
+    PlaneTables() {
+        for(int i = 0; i < 256; ++i) {
+            uint32_t rgb = nes_palette[i & 0x3F];
+            double r = rgb >> 16, g = (rgb >> 8) & 0xFF, b = rgb & 0xFF;
+            planes[0][i] = std::lround( 16 + ( 65.481 * r + 128.553 * g +  24.966 * b) / 255);
+            planes[1][i] = std::lround(128 + (-37.797 * r -  74.203 * g + 112.000 * b) / 255);
+            planes[2][i] = std::lround(128 + (112.000 * r -  93.786 * g -  18.214 * b) / 255);
+        }
+    }
+};
+
+static const PlaneTables &plane_tables() {
+    static const PlaneTables tables;
+    return tables;
+}
+
+void nes::palette_to_yuv_scalar(const uint8_t *indices, size_t count,
+        uint8_t *y, uint8_t *cb, uint8_t *cr) {
+    const PlaneTables &tables = plane_tables();
+    for(size_t i = 0; i < count; ++i) {
+        y[i] = tables.planes[0][indices[i]];
+        cb[i] = tables.planes[1][indices[i]];
+        cr[i] = tables.planes[2][indices[i]];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// PSHUFB looks up 16 entries at most, so the 64 entries of each table are
+// split in four. For the k-th quarter, indices get 16 * k subtracted, and then
+// 0x70 added with saturation: those that were in the quarter end up in 0x70 to
+// 0x7F, which PSHUFB takes to mean their low nibble, and all others end up at
+// 0x80 or above, which it takes to mean zero. ORing the four lookups together
+// makes up the whole table. With AVX2, each 128-bit lane shuffles on its own,
+// so the quarters are copied to both. Both return how many pixels they did,
+// and are compiled for their instruction set whatever the build targets, and
+// only called when the CPU supports it
+
+__attribute__((target("avx2")))
+static size_t palette_to_yuv_avx2(const uint8_t *indices, size_t count,
+        uint8_t *const out[3]) {
+    const PlaneTables &tables = plane_tables();
+    __m256i quarters[3][4];
+    for(int p = 0; p < 3; ++p)
+        for(int k = 0; k < 4; ++k)
+            quarters[p][k] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(tables.planes[p].data() + 16 * k)));
+    const __m256i mask = _mm256_set1_epi8(0x3F), bias = _mm256_set1_epi8(0x70),
+          step = _mm256_set1_epi8(16);
+    size_t i = 0;
+    for(; i + 32 <= count; i += 32) {
+        __m256i index = _mm256_and_si256(mask,
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i)));
+        __m256i select[4];
+        for(int k = 0; k < 4; ++k) {
+            select[k] = _mm256_adds_epu8(index, bias);
+            index = _mm256_sub_epi8(index, step);
+        }
+        for(int p = 0; p < 3; ++p) {
+            __m256i value = _mm256_shuffle_epi8(quarters[p][0], select[0]);
+            for(int k = 1; k < 4; ++k)
+                value = _mm256_or_si256(value, _mm256_shuffle_epi8(quarters[p][k], select[k]));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[p] + i), value);
+        }
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t palette_to_yuv_ssse3(const uint8_t *indices, size_t count,
+        uint8_t *const out[3]) {
+    const PlaneTables &tables = plane_tables();
+    __m128i quarters[3][4];
+    for(int p = 0; p < 3; ++p)
+        for(int k = 0; k < 4; ++k)
+            quarters[p][k] = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(tables.planes[p].data() + 16 * k));
+    const __m128i mask = _mm_set1_epi8(0x3F), bias = _mm_set1_epi8(0x70),
+          step = _mm_set1_epi8(16);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        __m128i index = _mm_and_si128(mask,
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)));
+        __m128i select[4];
+        for(int k = 0; k < 4; ++k) {
+            select[k] = _mm_adds_epu8(index, bias);
+            index = _mm_sub_epi8(index, step);
+        }
+        for(int p = 0; p < 3; ++p) {
+            __m128i value = _mm_shuffle_epi8(quarters[p][0], select[0]);
+            for(int k = 1; k < 4; ++k)
+                value = _mm_or_si128(value, _mm_shuffle_epi8(quarters[p][k], select[k]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out[p] + i), value);
+        }
+    }
+    return i;
+}
+#elif defined(__aarch64__)
+// TBL looks up as many as 64 entries at once, the whole table, so this is a
+// single instruction per plane. NEON is always there on AArch64
+static size_t palette_to_yuv_neon(const uint8_t *indices, size_t count,
+        uint8_t *const out[3]) {
+    const PlaneTables &tables = plane_tables();
+    uint8x16x4_t lookup[3];
+    for(int p = 0; p < 3; ++p)
+        for(int k = 0; k < 4; ++k)
+            lookup[p].val[k] = vld1q_u8(tables.planes[p].data() + 16 * k);
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        uint8x16_t index = vandq_u8(vld1q_u8(indices + i), mask);
+        for(int p = 0; p < 3; ++p)
+            vst1q_u8(out[p] + i, vqtbl4q_u8(lookup[p], index));
+    }
+    return i;
+}
+#endif
+
+void nes::palette_to_yuv(const uint8_t *indices, size_t count,
+        uint8_t *y, uint8_t *cb, uint8_t *cr) {
+    uint8_t *const out[3] = { y, cb, cr };
+    size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if(__builtin_cpu_supports("avx2"))
+        done = palette_to_yuv_avx2(indices, count, out);
+    else if(__builtin_cpu_supports("ssse3"))
+        done = palette_to_yuv_ssse3(indices, count, out);
+#elif defined(__aarch64__)
+    done = palette_to_yuv_neon(indices, count, out);
+#endif
+    // Whatever is left over, which is nothing for whole frames
+    palette_to_yuv_scalar(indices + done, count - done, y + done, cb + done, cr + done);
+}
+
+VideoRecorder::VideoRecorder(const std::string &path) : out(path) {
+    const char *header = "YUV4MPEG2 W256 H240 F60099:1000 Ip A8:7 C444\n";
+    std::vector<uint8_t> chunk(header, header + std::strlen(header));
+    out.submit(std::move(chunk));
+}
+
+void VideoRecorder::add_frame(const uint8_t *indices) {
+    const size_t pixels = width * height;
+    const char tag[] = "FRAME\n";
+    std::vector<uint8_t> chunk = out.acquire();
+    chunk.resize(sizeof(tag) - 1 + 3 * pixels);
+    std::memcpy(chunk.data(), tag, sizeof(tag) - 1);
+    uint8_t *y = chunk.data() + sizeof(tag) - 1;
+    palette_to_yuv(indices, pixels, y, y + pixels, y + 2 * pixels);
+    out.submit(std::move(chunk));
+}
+
+// Append a little endian integer to a buffer
+static void append(std::vector<uint8_t> &buffer, uint32_t value, int bytes) {
+    for(int i = 0; i < bytes; ++i)
+        buffer.push_back((value >> (8 * i)) & 0xFF);
+}
+
+AudioRecorder::AudioRecorder(const std::string &path, uint32_t sample_rate)
+        : out(path) {
+    std::vector<uint8_t> header;
+    const char *riff = "RIFF", *wave = "WAVEfmt ", *data = "data";
+    header.insert(header.end(), riff, riff + 4);
+    append(header, 0xFFFFFFFF, 4); // unknown size
+    header.insert(header.end(), wave, wave + 8);
+    append(header, 16, 4);              // size of the fmt chunk
+    append(header, 1, 2);               // PCM
+    append(header, 1, 2);               // mono
+    append(header, sample_rate, 4);
+    append(header, sample_rate * 2, 4); // bytes per second
+    append(header, 2, 2);               // bytes per sample frame
+    append(header, 16, 2);              // bits per sample
+    header.insert(header.end(), data, data + 4);
+    append(header, 0xFFFFFFFF, 4); // unknown size
+    out.submit(std::move(header));
+}
+
+void AudioRecorder::add_samples(const int16_t *samples, size_t count) {
+    std::vector<uint8_t> chunk = out.acquire();
+    chunk.resize(count * 2);
+    for(size_t i = 0; i < count; ++i) {
+        chunk[2 * i] = samples[i] & 0xFF;
+        chunk[2 * i + 1] = (samples[i] >> 8) & 0xFF;
+    }
+    out.submit(std::move(chunk));
+}
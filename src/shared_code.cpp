@@ -0,0 +1,146 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <dlfcn.h>
+#include <iostream>
+#include <map>
+#include "shared_code.hpp"
+
+using namespace nes;
+
+static std::atomic<size_t> capacity { 4096 };
+
+std::shared_ptr<SharedCode> SharedCode::get(uint64_t rom_hash) {
+    static std::mutex registry_mutex;
+    static std::map<uint64_t, std::weak_ptr<SharedCode>> registry;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::shared_ptr<SharedCode> code = registry[rom_hash].lock();
+    if(!code) {
+        // Forget about the ROMs nobody is running anymore while at it
+        for(auto it = registry.begin(); it != registry.end();)
+            it = it->second.expired() ? registry.erase(it) : std::next(it);
+        code = std::make_shared<SharedCode>(rom_hash);
+        registry[rom_hash] = code;
+    }
+    return code;
+}
+
+void SharedCode::set_capacity(size_t blocks) {
+    capacity.store(blocks);
+}
+
+SharedCode::~SharedCode() {
+    // Nobody is attached anymore, or this wouldn't be going away
+    for(const auto &module : resident)
+        dlclose(module->handle);
+    for(const auto &module : retired)
+        dlclose(module->handle);
+}
+
+bool SharedCode::publish(const std::string &path, const std::vector<uint16_t> &claims) {
+    void *lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    auto info = lib ? static_cast<const nes_aot_module*>(dlsym(lib, "nes_aot_module_info")) : nullptr;
+    if(!info || info->abi_version != NES_AOT_ABI_VERSION || info->rom_hash != rom_hash) {
+        std::cerr << "Could not load " << path << " to share it\n";
+        if(lib) dlclose(lib);
+        for(uint16_t addr : claims)
+            release(addr);
+        return false;
+    }
+
+    // The slots are all in place before any of them is published, as
+    // their addresses must not change from then on
+    auto module = std::make_unique<Module>();
+    module->handle = lib;
+    for(uint32_t i = 0; i < info->block_count; ++i) {
+        const nes_aot_block_info &block = info->blocks[i];
+        if(block.addr >= 0x8000 && block.size != 0)
+            module->slots.push_back({ &block, module.get() });
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(const Slot &slot : module->slots)
+            table[slot.block->addr - 0x8000].store(&slot, std::memory_order_release);
+        blocks += module->slots.size();
+        resident.push_back(std::move(module));
+        evict();
+    }
+    if(retiring.load(std::memory_order_relaxed)) reclaim();
+    return true;
+}
+
+void SharedCode::evict() {
+    size_t limit = capacity.load(std::memory_order_relaxed);
+    // Modules in use get two sweeps' worth of chances, as other instances
+    // keep marking them while we go
+    size_t chances = 2 * resident.size();
+    // The module just published is left out, or it could go right away
+    while(blocks > limit && resident.size() > 1) {
+        if(hand >= resident.size() - 1) hand = 0;
+        Module &module = *resident[hand];
+        if(chances > 0 && module.referenced.exchange(false, std::memory_order_relaxed)) {
+            --chances;
+            ++hand;
+            continue;
+        }
+        for(const Slot &slot : module.slots) {
+            // Another module may have taken over the address
+            const Slot *expected = &slot;
+            unsigned i = slot.block->addr - 0x8000;
+            if(table[i].compare_exchange_strong(expected, nullptr))
+                claimed[i].store(false);
+        }
+        blocks -= module.slots.size();
+        // Instances may only have found its blocks before the epoch changed
+        module.retired = epoch.fetch_add(1) + 1;
+        retired.push_back(std::move(resident[hand]));
+        resident.erase(resident.begin() + hand);
+        retiring.store(true, std::memory_order_relaxed);
+        eviction_count.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void SharedCode::reclaim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t oldest = epoch.load();
+    for(const Reader *reader : readers)
+        oldest = std::min(oldest, reader->seen.load());
+    for(auto it = retired.begin(); it != retired.end();) {
+        if((*it)->retired <= oldest) {
+            dlclose((*it)->handle);
+            it = retired.erase(it);
+        }
+        else ++it;
+    }
+    retiring.store(!retired.empty(), std::memory_order_relaxed);
+}
+
+void SharedCode::attach(Reader &reader) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reader.seen.store(epoch.load());
+    readers.push_back(&reader);
+}
+
+void SharedCode::detach(Reader &reader) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readers.erase(std::remove(readers.begin(), readers.end(), &reader), readers.end());
+    }
+    if(retiring.load(std::memory_order_relaxed)) reclaim();
+}
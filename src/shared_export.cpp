@@ -0,0 +1,89 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "emulator.hpp"
+#include "shared_export.hpp"
+
+using namespace nes;
+
+SharedExport::SharedExport(const std::string &name) : name(name) {
+    // Another instance may be exporting under the same name, and replacing
+    // its segment would pull the rug from under its readers
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0 && errno == EEXIST) {
+        std::cerr << "Shared memory segment " << name << " is already in use"
+            " (if its creator crashed, remove it from /dev/shm)\n";
+        return;
+    }
+    if(fd < 0) {
+        std::cerr << "Could not create shared memory segment " << name << '\n';
+        return;
+    }
+    if(ftruncate(fd, sizeof(SharedSegment)) < 0) {
+        std::cerr << "Could not size shared memory segment " << name << '\n';
+        close(fd);
+        shm_unlink(name.c_str());
+        return;
+    }
+    void *mem = mmap(nullptr, sizeof(SharedSegment), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        std::cerr << "Could not map shared memory segment " << name << '\n';
+        shm_unlink(name.c_str());
+        return;
+    }
+    segment = new(mem) SharedSegment;
+    std::memcpy(segment->magic, "LIBRENES", 8);
+    segment->version = 1;
+    segment->ram_size = sizeof(segment->ram);
+    segment->prg_ram_size = sizeof(segment->prg_ram);
+    segment->framebuffer_size = 0;
+    segment->audio_size = 0;
+    segment->reserved = 0;
+    segment->sequence.store(0, std::memory_order_relaxed);
+    segment->frame = 0;
+}
+
+SharedExport::~SharedExport() {
+    if(segment == nullptr) return;
+    segment->~SharedSegment();
+    munmap(segment, sizeof(SharedSegment));
+    shm_unlink(name.c_str());
+}
+
+void SharedExport::publish(const Emulator &nes_emu) {
+    // Readers must see the counter go odd before any of the data changes,
+    // and the data settle before it goes even again
+    uint64_t seq = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->frame = nes_emu.get_frame();
+    const auto &ram = nes_emu.get_ram();
+    std::memcpy(segment->ram, ram.data(), ram.size());
+    const auto &prg_ram = nes_emu.get_prg_ram();
+    std::memcpy(segment->prg_ram, prg_ram.data(), prg_ram.size());
+    segment->sequence.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,262 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "emulator.hpp"
+
+// Headless runner for accuracy test ROMs. Most of them (all of blargg's, for
+// one) follow the same protocol to report their results: once the signature
+// DE B0 61 is present at $6001-$6003, the byte at $6000 tells the status of
+// the test, and a zero-terminated message can be found from $6004 on. A status
+// of $80 means the test is still running, $81 means it wants the console to be
+// reset and anything else is the final result, where 0 means success. Watching
+// these bytes lets us stop each ROM as soon as it is done, instead of running
+// it for a fixed number of frames. ROMs that crash are stopped as soon as they
+// are found to be halted (see Emulator::set_halt_detection), for the same
+// reason.
+
+namespace fs = std::filesystem;
+
+// Outcome of running a single test ROM
+struct Result {
+    std::string path;
+    std::string outcome; // "passed", "failed", "halted", "timeout" or "error"
+    int status = -1;
+    std::string message;
+    uint64_t frames = 0;
+    double seconds = 0;
+};
+
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [options] DIR\n"
+        "  --jobs N            number of ROMs to run at once\n"
+        "                      (default: number of hardware threads)\n"
+        "  --max-frames N      give up on a ROM after N frames (default: 3600)\n"
+        "  --junit FILE        also write a JUnit XML summary to FILE\n"
+        "A JSON summary is written to stdout. Exits with 1 unless every ROM\n"
+        "passed.\n";
+}
+
+static bool has_signature(const nes::Emulator &nes_emu) {
+    return nes_emu.read(0x6001) == 0xDE && nes_emu.read(0x6002) == 0xB0
+        && nes_emu.read(0x6003) == 0x61;
+}
+
+static std::string read_message(const nes::Emulator &nes_emu) {
+    std::string message;
+    for(uint16_t addr = 0x6004; addr < 0x8000; ++addr) {
+        char c = nes_emu.read(addr);
+        if(c == '\0') break;
+        message += c;
+    }
+    return message;
+}
+
+static void run_rom(Result &result, uint64_t max_frames) {
+    auto begin = std::chrono::steady_clock::now();
+    nes::Emulator nes_emu;
+    nes_emu.set_halt_detection(true);
+    if(!nes_emu.load_rom_file(result.path)) {
+        result.outcome = "error";
+    } else {
+        result.outcome = "timeout";
+        // Frame on which a reset was requested, if it was
+        uint64_t reset_frame = 0;
+        bool reset_pending = false;
+        while(result.frames < max_frames) {
+            nes_emu.run_frame();
+            ++result.frames;
+            // A test that is still running (or never started) will never
+            // finish once halted. One waiting for a reset is halted anyway
+            bool running = !has_signature(nes_emu) || nes_emu.read(0x6000) == 0x80;
+            if(running && nes_emu.is_halted()) {
+                result.outcome = "halted";
+                break;
+            }
+            if(running) continue;
+            uint8_t status = nes_emu.read(0x6000);
+            if(status == 0x81) {
+                // The protocol asks for the reset to come at least 100ms
+                // later, which is about 6 frames
+                if(!reset_pending) {
+                    reset_pending = true;
+                    reset_frame = result.frames;
+                } else if(result.frames - reset_frame >= 6) {
+                    reset_pending = false;
+                    nes_emu.reset();
+                }
+                continue;
+            }
+            result.status = status;
+            result.outcome = status == 0 ? "passed" : "failed";
+            break;
+        }
+        if(has_signature(nes_emu))
+            result.message = read_message(nes_emu);
+        if(result.outcome == "halted") {
+            char where[64];
+            snprintf(where, sizeof(where), "halted at $%04X on frame %llu",
+                    nes_emu.get_halt_pc(), (unsigned long long) nes_emu.get_halt_frame());
+            result.message = result.message.empty() ? where : where + (": " + result.message);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - begin).count();
+}
+
+// Escape a string for both JSON and XML output. Test messages are plain ASCII
+// text, but we cannot trust a ROM that failed to behave
+static std::string escape(const std::string &str, bool xml) {
+    std::string out;
+    for(char c : str) {
+        if(xml && c == '<') out += "&lt;";
+        else if(xml && c == '>') out += "&gt;";
+        else if(xml && c == '&') out += "&amp;";
+        else if(xml && c == '"') out += "&quot;";
+        else if(!xml && (c == '"' || c == '\\')) (out += '\\') += c;
+        else if(!xml && c == '\n') out += "\\n";
+        else if(c < 0x20 && c != '\n') out += '?';
+        else out += c;
+    }
+    return out;
+}
+
+static void write_json(const std::vector<Result> &results, double seconds) {
+    printf("{\n  \"seconds\": %.3f,\n  \"results\": [\n", seconds);
+    for(size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        printf("    {\"rom\": \"%s\", \"outcome\": \"%s\", \"status\": %d, "
+               "\"frames\": %llu, \"seconds\": %.3f, \"message\": \"%s\"}%s\n",
+               escape(r.path, false).c_str(), r.outcome.c_str(), r.status,
+               (unsigned long long) r.frames, r.seconds,
+               escape(r.message, false).c_str(),
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+static bool write_junit(const std::string &path, const std::vector<Result> &results,
+        double seconds) {
+    std::ofstream out(path);
+    if(!out) return false;
+    size_t failures = 0, errors = 0;
+    for(const Result &r : results) {
+        if(r.outcome == "failed" || r.outcome == "halted" || r.outcome == "timeout")
+            ++failures;
+        else if(r.outcome == "error") ++errors;
+    }
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<testsuite name=\"libre-nes\" tests=\"" << results.size()
+        << "\" failures=\"" << failures << "\" errors=\"" << errors
+        << "\" time=\"" << seconds << "\">\n";
+    for(const Result &r : results) {
+        out << "  <testcase name=\"" << escape(r.path, true) << "\" time=\""
+            << r.seconds << "\"";
+        if(r.outcome == "passed") {
+            out << "/>\n";
+            continue;
+        }
+        out << ">\n";
+        if(r.outcome == "error")
+            out << "    <error message=\"could not load ROM\"/>\n";
+        else
+            out << "    <failure message=\"" << r.outcome << " (status "
+                << r.status << ")\">" << escape(r.message, true) << "</failure>\n";
+        out << "  </testcase>\n";
+    }
+    out << "</testsuite>\n";
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::string dir, junit;
+    uint64_t max_frames = 3600;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg[0] != '-') {
+            dir = arg;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if(arg == "--jobs") jobs = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if(arg == "--max-frames") max_frames = std::strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--junit") junit = argv[++i];
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if(dir.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Result> results;
+    std::error_code err;
+    for(const auto &entry : fs::recursive_directory_iterator(dir, err)) {
+        if(entry.is_regular_file() && entry.path().extension() == ".nes") {
+            results.emplace_back();
+            results.back().path = entry.path().string();
+        }
+    }
+    if(err) {
+        std::cerr << "Could not read " << dir << ": " << err.message() << '\n';
+        return EXIT_FAILURE;
+    }
+    std::sort(results.begin(), results.end(),
+            [](const Result &a, const Result &b) { return a.path < b.path; });
+
+    // Each worker keeps taking the next ROM nobody has taken yet. Every ROM
+    // gets an emulator of its own, so there is nothing else to synchronize
+    auto begin = std::chrono::steady_clock::now();
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < std::min<size_t>(jobs, results.size()); ++i) {
+        workers.emplace_back([&] {
+            for(size_t j = next++; j < results.size(); j = next++)
+                run_rom(results[j], max_frames);
+        });
+    }
+    for(auto &worker : workers) worker.join();
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+
+    write_json(results, seconds);
+    if(!junit.empty() && !write_junit(junit, results, seconds)) {
+        std::cerr << "Could not write " << junit << '\n';
+        return EXIT_FAILURE;
+    }
+    bool all_passed = std::all_of(results.begin(), results.end(),
+            [](const Result &r) { return r.outcome == "passed"; });
+    return all_passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,220 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include "emulator.hpp"
+#include "native_module.hpp"
+#include "tiering.hpp"
+
+using namespace nes;
+
+TieredCompiler::TieredCompiler(const Emulator &nes_emu, NativeModule &native,
+        const std::string &compiler, const std::string &include_dir,
+        const std::string &cache_dir)
+    : nes_emu(nes_emu), native(native), shared(native.shared_code()),
+      compiler(compiler), include_dir(include_dir) {
+    rom_hash = nes_emu.hash_prg_rom();
+    if(shared) evictions_seen = shared->evictions();
+    const char *tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/libre-nes-XXXXXX";
+    if(!mkdtemp(&pattern[0])) {
+        std::cerr << "Could not create a directory for compiled code\n";
+        return;
+    }
+    dir = pattern;
+    if(!cache_dir.empty()) {
+        cache = std::make_unique<CodeCache>(cache_dir, rom_hash);
+        if(!cache->ok()) return;
+        // Whatever got hot last time will most likely get hot again, so it
+        // makes up the first batch
+        for(uint32_t addr = 0x8000; addr <= 0xFFFF; ++addr)
+            if(cache->was_hot(addr)) promote(addr);
+        pending.cached = !pending.blocks.empty();
+        pending_shared.cached = !pending_shared.blocks.empty();
+    }
+    worker = std::thread(&TieredCompiler::work, this);
+}
+
+TieredCompiler::~TieredCompiler() {
+    if(worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+    // Modules are removed as soon as they are loaded, but the ones that
+    // never were are still around. Whatever we claimed and didn't share,
+    // someone else may compile
+    for(const Batch &batch : done) {
+        if(!batch.cached) unlink(batch.path.c_str());
+        if(batch.shared)
+            for(const CodeBlock &block : batch.blocks)
+                shared->release(block.addr);
+    }
+    for(const CodeBlock &block : pending_shared.blocks)
+        shared->release(block.addr);
+    if(!dir.empty()) rmdir(dir.c_str());
+}
+
+void TieredCompiler::promote(uint16_t addr) {
+    if(!ok() || invalidations[addr - base] >= demote_threshold) return;
+    // The block is decoded right away, on this thread, as the worker can't
+    // look at memory while the emulator is running
+    CodeBlock block = decode_block(nes_emu, addr);
+    if(block.instructions.empty()) return;
+    // Unless our ROM is patched, program ROM code is the same for every
+    // instance running it. If another one is compiling it already, we may
+    // as well wait for it, and check again once it gets hot again. The rest
+    // of the block is covered either way
+    bool share = shared && addr >= 0x8000 && !nes_emu.is_rom_patched();
+    if(share && !shared->claim(addr)) {
+        for(const Instruction &inst : block.instructions)
+            heat[inst.addr - base] = promote_threshold;
+        heat[addr - base] = 0;
+        return;
+    }
+    // The rest of the block is about as hot, but it is covered now
+    for(const Instruction &inst : block.instructions)
+        heat[inst.addr - base] = promote_threshold;
+    if(cache) cache->mark_hot(addr);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        (share ? pending_shared : pending).blocks.push_back(std::move(block));
+    }
+    wake.notify_one();
+}
+
+void TieredCompiler::install() {
+    std::vector<Batch> batches;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batches.swap(done);
+        ready.store(false, std::memory_order_relaxed);
+    }
+    for(const Batch &batch : batches) {
+        bool loaded = false;
+        if(batch.shared) {
+            std::vector<uint16_t> claims;
+            for(const CodeBlock &block : batch.blocks)
+                claims.push_back(block.addr);
+            if(batch.compiled) loaded = shared->publish(batch.path, claims);
+            else for(uint16_t addr : claims) shared->release(addr);
+        }
+        else loaded = batch.compiled && native.load(batch.path, rom_hash);
+        if(!batch.cached) unlink(batch.path.c_str());
+        if(!loaded) continue;
+        // The code may have changed while it was being compiled
+        for(const CodeBlock &block : batch.blocks) {
+            for(const Instruction &inst : block.instructions) {
+                Instruction now = decode(nes_emu, inst.addr);
+                if(now.opcode != inst.opcode || now.value() != inst.value()) {
+                    const Instruction &last = block.instructions.back();
+                    invalidated(native.invalidate(block.addr, last.addr + last.size - 1));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void TieredCompiler::rewarm() {
+    evictions_seen = shared->evictions();
+    // Whatever is still shared stays claimed
+    for(uint32_t addr = 0x8000; addr <= 0xFFFF; ++addr)
+        if(heat[addr - base] == promote_threshold && !shared->is_claimed(addr))
+            heat[addr - base] = 0;
+}
+
+void TieredCompiler::invalidated(const std::vector<uint16_t> &addrs) {
+    for(uint16_t addr : addrs) {
+        if(addr < base) continue;
+        uint8_t &count = invalidations[addr - base];
+        if(count < demote_threshold) ++count;
+        // Let it get hot all over again, unless it was demoted for good
+        if(count < demote_threshold) heat[addr - base] = 0;
+    }
+}
+
+void TieredCompiler::work() {
+    unsigned serial = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        wake.wait(lock, [this] {
+            return quit || !pending.blocks.empty() || !pending_shared.blocks.empty();
+        });
+        if(quit) return;
+        std::vector<Batch> batches;
+        for(Batch *queue : { &pending, &pending_shared }) {
+            if(queue->blocks.empty()) continue;
+            batches.push_back(std::move(*queue));
+            batches.back().shared = queue == &pending_shared;
+            *queue = Batch();
+        }
+        lock.unlock();
+
+        for(Batch &batch : batches) {
+            // A block may have been promoted again before it was compiled
+            std::sort(batch.blocks.begin(), batch.blocks.end(),
+                    [](const CodeBlock &a, const CodeBlock &b) { return a.addr < b.addr; });
+            batch.blocks.erase(std::unique(batch.blocks.begin(), batch.blocks.end(),
+                    [](const CodeBlock &a, const CodeBlock &b) { return a.addr == b.addr; }),
+                    batch.blocks.end());
+            build(batch, emit_module(batch.blocks, rom_hash), serial++);
+        }
+
+        lock.lock();
+        for(Batch &batch : batches)
+            done.push_back(std::move(batch));
+        ready.store(true, std::memory_order_release);
+    }
+}
+
+void TieredCompiler::build(Batch &batch, const std::string &code, unsigned serial) {
+    std::string name = dir + "/tier" + std::to_string(serial);
+    std::string output = name + ".so";
+    if(batch.cached) {
+        batch.path = cache->module_path(code, compiler);
+        if(access(batch.path.c_str(), F_OK) == 0) {
+            batch.compiled = true;
+            return;
+        }
+        // Compiled right next to where it is kept, so that it can be moved
+        // there in one go
+        output = batch.path + "." + std::to_string(getpid()) + ".tmp";
+    }
+    else batch.path = output;
+
+    std::string source = name + ".cpp";
+    {
+        std::ofstream file(source);
+        file << code;
+    }
+    batch.compiled = compile_module(source, output, compiler, include_dir);
+    unlink(source.c_str());
+    if(batch.cached) {
+        if(batch.compiled) batch.compiled = cache->store(output, batch.path);
+        else unlink(output.c_str());
+    }
+}
@@ -0,0 +1,84 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "workloads.hpp"
+
+using namespace nes;
+
+const std::vector<std::string> nes::workload_names = { "alu", "memory", "stack" };
+
+// Every workload is a single loop starting at $8000. It jumps back through
+// the pointer at $FFF0, which is set up by build_workload
+static const std::vector<uint8_t> alu_prog {
+    0xA9, 0x55,       // lda #$55
+    0x29, 0x0F,       // and #$0F
+    0x0A,             // asl a
+    0xA0, 0x04,       // ldy #$04
+    0x11, 0x03,       // ora ($03),y
+    0x3E, 0x00, 0x02, // rol $0200,x
+    0x56, 0x10,       // lsr $10,x
+    0x6C, 0xF0, 0xFF, // jmp ($FFF0)
+};
+
+static const std::vector<uint8_t> memory_prog {
+    0xA2, 0x10,       // ldx #$10
+    0xA0, 0x20,       // ldy #$20
+    0xA9, 0xAA,       // lda #$AA
+    0x99, 0x00, 0x03, // sta $0300,y
+    0x81, 0x40,       // sta ($40,x)
+    0xA5, 0x50,       // lda $50
+    0xB6, 0x60,       // ldx $60,y
+    0x0E, 0x00, 0x04, // asl $0400
+    0x06, 0x70,       // asl $70
+    0x6C, 0xF0, 0xFF, // jmp ($FFF0)
+};
+
+static const std::vector<uint8_t> stack_prog {
+    0xA9, 0x01,       // lda #$01
+    0x48,             // pha
+    0x08,             // php
+    0x48,             // pha
+    0x38,             // sec
+    0xF0, 0x00,       // beq +0
+    0x6C, 0xF0, 0xFF, // jmp ($FFF0)
+};
+
+bool nes::build_workload(const std::string &name, std::vector<uint8_t> &image) {
+    const std::vector<uint8_t> *prog;
+    if(name == "alu") prog = &alu_prog;
+    else if(name == "memory") prog = &memory_prog;
+    else if(name == "stack") prog = &stack_prog;
+    else return false;
+
+    // iNES header for a 16KiB NROM cartridge with no CHR ROM
+    image.assign(16 + 0x4000, 0xEA); // nop
+    const uint8_t header[16] = { 'N', 'E', 'S', 0x1A, 0x01 };
+    std::copy(header, header + 16, image.begin());
+    uint8_t *prg = image.data() + 16;
+    std::copy(prog->begin(), prog->end(), prg);
+    // Loop pointer at $FFF0 and reset vector at $FFFC, both pointing to $8000
+    prg[0x3FF0] = 0x00;
+    prg[0x3FF1] = 0x80;
+    prg[0x3FFC] = 0x00;
+    prg[0x3FFD] = 0x80;
+    return true;
+}
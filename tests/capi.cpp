@@ -0,0 +1,69 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include "check.hpp"
+#include "libnes.h"
+
+// The C interface, including the inputs that used to throw C++ exceptions
+// straight through it
+
+static int frames = 0;
+
+static void count_frame(nes_emulator *, void *) {
+    ++frames;
+}
+
+int main() {
+    std::vector<uint8_t> image = nes_test::make_rom({
+        0xE6, 0x00,       // inc $00
+        0x4C, 0x00, 0x80, // jmp $8000
+    });
+    nes_emulator *emu = nes_create();
+    CHECK(emu != nullptr);
+    CHECK(nes_load_rom(emu, image.data(), image.size()) == 0);
+    CHECK(nes_load_rom(emu, image.data(), 8) == -1);
+    CHECK(nes_load_rom(emu, image.data(), image.size()) == 0);
+
+    CHECK(nes_add_cheat(emu, nullptr) == -1);
+    CHECK(nes_add_cheat(emu, "SXIOP ") == -1);
+    CHECK(nes_add_cheat(emu, "0010:42") == 0);
+    CHECK(nes_export_shared(emu, nullptr) == -1);
+    CHECK(nes_record_video(emu, nullptr) == -1);
+    CHECK(nes_record_audio(emu, nullptr, 44100) == -1);
+    CHECK(nes_record_audio(emu, "/dev/null", 0) == -1);
+    CHECK(nes_add_frame_hook(emu, nullptr, nullptr) == -1);
+    CHECK(nes_add_exec_hook(emu, 0x8000, nullptr, nullptr) == -1);
+    CHECK(nes_add_write_hook(emu, 0x0000, nullptr, nullptr) == -1);
+
+    int id = nes_add_frame_hook(emu, count_frame, nullptr);
+    CHECK(id >= 0);
+    CHECK(nes_run_frame(emu) > 0);
+    CHECK(frames == 1);
+    CHECK(nes_ram(emu)[0x10] == 0x42);
+    CHECK(nes_remove_hook(emu, id) == 0);
+    CHECK(nes_remove_hook(emu, id) == -1);
+
+    std::vector<uint8_t> state(nes_state_size());
+    CHECK(nes_save_state(emu, state.data(), state.size()) == 0);
+    CHECK(nes_load_state(emu, state.data(), state.size() - 1) == -1);
+    state[0] ^= 0xFF;
+    CHECK(nes_load_state(emu, state.data(), state.size()) == -1);
+    nes_destroy(emu);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NES_TESTS_CHECK_HPP
+#define NES_TESTS_CHECK_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "disassembler.hpp"
+#include "emulator.hpp"
+#include "recompiler.hpp"
+
+// Bits and pieces shared by the regression tests, which are plain programs
+// that exit with a non-zero status on the first check that fails.
+
+#define CHECK(cond) do { \
+    if(!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        exit(EXIT_FAILURE); \
+    } \
+} while(0)
+
+namespace nes_test {
+    // Build the iNES image of a 16KiB NROM cartridge with the given program
+    // at $8000, where the reset vector points, and NOPs everywhere else
+    inline std::vector<uint8_t> make_rom(const std::vector<uint8_t> &prog) {
+        std::vector<uint8_t> image(16 + 0x4000, 0xEA);
+        const uint8_t header[16] = { 'N', 'E', 'S', 0x1A, 0x01 };
+        std::copy(header, header + 16, image.begin());
+        std::copy(prog.begin(), prog.end(), image.begin() + 16);
+        image[16 + 0x3FFC] = 0x00;
+        image[16 + 0x3FFD] = 0x80;
+        return image;
+    }
+
+    // Whether two instances are in the exact same state, as far as the CPU
+    // and memory go
+    inline bool same_state(const nes::Emulator &a, const nes::Emulator &b) {
+        nes::CpuState sa = a.get_cpu_state(), sb = b.get_cpu_state();
+        return sa.pc == sb.pc && sa.acc == sb.acc && sa.x == sb.x && sa.y == sb.y
+            && sa.status == sb.status && sa.stack_ptr == sb.stack_ptr
+            && sa.cycles == sb.cycles && a.hash_ram() == b.hash_ram();
+    }
+
+    // Recompile a ROM ahead of time, like libre-nes-aot, into a module at
+    // the given path. Needs the system's compiler
+    inline void compile_aot(const std::vector<uint8_t> &image, const std::string &output) {
+        nes::Emulator nes_emu;
+        CHECK(nes_emu.load_rom(image.data(), image.size()));
+        nes::Disassembler disassembler(nes_emu);
+        std::vector<nes::CodeBlock> blocks = nes::find_blocks(nes_emu,
+                disassembler.disassemble());
+        std::string source = output + ".cpp";
+        std::ofstream(source) << nes::emit_module(blocks, nes_emu.hash_prg_rom());
+        CHECK(nes::compile_module(source, output, nes::default_compiler(),
+                    nes::default_include_dir()));
+        remove(source.c_str());
+    }
+}
+
+#endif // NES_TESTS_CHECK_HPP
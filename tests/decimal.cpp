@@ -0,0 +1,175 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include "check.hpp"
+#include "processor.hpp"
+
+// ADC and SBC in decimal mode, for every accumulator, operand and carry, on
+// the variants that have it. The expected results come from the reference
+// algorithms in Bruce Clark's "Decimal Mode" tutorial (appendix B), which
+// model the real chips for invalid BCD operands too, and which Klaus
+// Dormann's decimal test is built on. The 2A03 has to ignore decimal mode
+
+namespace {
+    const uint8_t flag_c = 0x01, flag_z = 0x02, flag_d = 0x08, flag_v = 0x40, flag_n = 0x80;
+    const uint8_t op_adc_imm = 0x69, op_sbc_imm = 0xE9;
+
+    struct Result {
+        uint8_t acc;
+        uint8_t flags; // N, V, Z and C only
+    };
+
+    // Sequences 1 and 2: the NMOS accumulator and carry, and the N and V
+    // flags, which come from before the upper digit is adjusted
+    Result adc_nmos(uint8_t a, uint8_t b, bool carry) {
+        int al = (a & 0x0F) + (b & 0x0F) + carry;
+        if(al >= 0x0A) al = ((al + 0x06) & 0x0F) + 0x10;
+        int sum = (a & 0xF0) + (b & 0xF0) + al;
+        int signed_sum = static_cast<int8_t>(a & 0xF0) + static_cast<int8_t>(b & 0xF0) + al;
+        uint8_t flags = 0;
+        if(signed_sum & 0x80) flags |= flag_n;
+        if(signed_sum < -128 || signed_sum > 127) flags |= flag_v;
+        if(sum >= 0xA0) sum += 0x60;
+        if(sum >= 0x100) flags |= flag_c;
+        // Z is the binary result's
+        if(((a + b + carry) & 0xFF) == 0) flags |= flag_z;
+        return { static_cast<uint8_t>(sum), flags };
+    }
+
+    // The 65C02 gets the same accumulator, carry and V, with N and Z fixed
+    // to match the accumulator
+    Result adc_cmos(uint8_t a, uint8_t b, bool carry) {
+        Result result = adc_nmos(a, b, carry);
+        result.flags &= flag_c | flag_v;
+        if(result.acc & 0x80) result.flags |= flag_n;
+        if(result.acc == 0) result.flags |= flag_z;
+        return result;
+    }
+
+    // The flags of a binary subtraction, which SBC keeps in decimal mode
+    // (N and Z only on the NMOS chips)
+    uint8_t sbc_binary_flags(uint8_t a, uint8_t b, bool carry) {
+        int diff = a - b - !carry;
+        uint8_t result = diff;
+        uint8_t flags = 0;
+        if(diff >= 0) flags |= flag_c;
+        if(((a ^ b) & (a ^ result)) & 0x80) flags |= flag_v;
+        if(result & 0x80) flags |= flag_n;
+        if(result == 0) flags |= flag_z;
+        return flags;
+    }
+
+    // Sequence 3: the NMOS accumulator
+    Result sbc_nmos(uint8_t a, uint8_t b, bool carry) {
+        int al = (a & 0x0F) - (b & 0x0F) + carry - 1;
+        if(al < 0) al = ((al - 0x06) & 0x0F) - 0x10;
+        int diff = (a & 0xF0) - (b & 0xF0) + al;
+        if(diff < 0) diff -= 0x60;
+        return { static_cast<uint8_t>(diff), sbc_binary_flags(a, b, carry) };
+    }
+
+    // Sequence 4: the 65C02 accumulator, with N and Z to match it
+    Result sbc_cmos(uint8_t a, uint8_t b, bool carry) {
+        int al = (a & 0x0F) - (b & 0x0F) + carry - 1;
+        int diff = a - b + carry - 1;
+        if(diff < 0) diff -= 0x60;
+        if(al < 0) diff -= 0x06;
+        uint8_t acc = diff;
+        uint8_t flags = sbc_binary_flags(a, b, carry) & (flag_c | flag_v);
+        if(acc & 0x80) flags |= flag_n;
+        if(acc == 0) flags |= flag_z;
+        return { acc, flags };
+    }
+
+    // Plain binary addition and subtraction, for the 2A03
+    Result adc_binary(uint8_t a, uint8_t b, bool carry) {
+        int sum = a + b + carry;
+        uint8_t acc = sum;
+        uint8_t flags = 0;
+        if(sum > 0xFF) flags |= flag_c;
+        if((~(a ^ b) & (a ^ acc)) & 0x80) flags |= flag_v;
+        if(acc & 0x80) flags |= flag_n;
+        if(acc == 0) flags |= flag_z;
+        return { acc, flags };
+    }
+
+    Result sbc_binary(uint8_t a, uint8_t b, bool carry) {
+        return { static_cast<uint8_t>(a - b - !carry), sbc_binary_flags(a, b, carry) };
+    }
+
+    // Run a single immediate ADC or SBC with decimal mode on, checking the
+    // result against the expected one, and the extra cycle the 65C02 takes
+    template<typename Variant>
+    void check_all(uint8_t opcode, Result (*expected)(uint8_t, uint8_t, bool),
+            const char *name) {
+        nes::FlatBus bus;
+        nes::BasicProcessor<Variant, nes::FlatBus> cpu(bus);
+        bus.memory[0x0200] = opcode;
+        for(int a = 0; a < 256; ++a) {
+            for(int b = 0; b < 256; ++b) {
+                for(int carry = 0; carry < 2; ++carry) {
+                    bus.memory[0x0201] = b;
+                    nes::CpuState state;
+                    state.pc = 0x0200;
+                    state.acc = a;
+                    state.status = flag_d | carry;
+                    cpu.set_state(state);
+                    cpu.single_step();
+                    nes::CpuState after = cpu.get_state();
+                    Result want = expected(a, b, carry);
+                    uint8_t flags = after.status & (flag_n | flag_v | flag_z | flag_c);
+                    uint64_t cycles = Variant::cmos && Variant::decimal_mode ? 3 : 2;
+                    if(after.acc != want.acc || flags != want.flags
+                            || after.cycles != cycles) {
+                        fprintf(stderr, "%s $%02X, #$%02X, carry %d: got $%02X with flags "
+                                "$%02X in %llu cycles, expected $%02X with flags $%02X\n",
+                                name, a, b, carry, after.acc, flags,
+                                static_cast<unsigned long long>(after.cycles),
+                                want.acc, want.flags);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    // A few results known by heart, to keep the models honest
+    auto is = [](Result result, uint8_t acc, uint8_t flags) {
+        return result.acc == acc && result.flags == flags;
+    };
+    CHECK(is(adc_nmos(0x12, 0x34, false), 0x46, 0));
+    CHECK(is(adc_nmos(0x58, 0x46, true), 0x05, flag_n | flag_v | flag_c));
+    CHECK(is(adc_nmos(0x99, 0x01, false), 0x00, flag_n | flag_c));
+    CHECK(is(adc_cmos(0x99, 0x01, false), 0x00, flag_z | flag_c));
+    CHECK(is(sbc_nmos(0x46, 0x12, true), 0x34, flag_c));
+    CHECK(is(sbc_nmos(0x40, 0x13, true), 0x27, flag_c));
+    CHECK(is(sbc_nmos(0x32, 0x02, false), 0x29, flag_c));
+    CHECK(is(sbc_nmos(0x12, 0x21, true), 0x91, flag_n));
+    CHECK(is(sbc_cmos(0x12, 0x21, true), 0x91, flag_n));
+
+    check_all<nes::Nmos6502>(op_adc_imm, adc_nmos, "NMOS ADC");
+    check_all<nes::Nmos6502>(op_sbc_imm, sbc_nmos, "NMOS SBC");
+    check_all<nes::Wdc65C02>(op_adc_imm, adc_cmos, "65C02 ADC");
+    check_all<nes::Wdc65C02>(op_sbc_imm, sbc_cmos, "65C02 SBC");
+    check_all<nes::Ricoh2A03>(op_adc_imm, adc_binary, "2A03 ADC");
+    check_all<nes::Ricoh2A03>(op_sbc_imm, sbc_binary, "2A03 SBC");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <random>
+#include <vector>
+#include "check.hpp"
+#include "disassembler.hpp"
+#include "emulator.hpp"
+
+// The disassembler's bank caches, which must notice code changing in RAM and
+// program RAM however it gets written, without looking at every bank, and its
+// incremental tracing, which must end up where tracing from scratch would
+
+// The instruction at the given address in a listing, which has to be there
+static nes::Instruction find(const std::vector<nes::Instruction> &listing, uint16_t addr) {
+    for(const nes::Instruction &inst : listing)
+        if(inst.addr == addr) return inst;
+    CHECK(!"listed");
+    return nes::Instruction();
+}
+
+int main() {
+    std::vector<uint8_t> image = nes_test::make_rom({
+        0xA9, 0xE8,       // lda #$E8 (INX)
+        0x8D, 0x00, 0x03, // sta $0300
+        0x8D, 0x00, 0x60, // sta $6000
+        0x4C, 0x00, 0x60, // jmp $6000
+    });
+    nes::Emulator nes_emu;
+    CHECK(nes_emu.load_rom(image.data(), image.size()));
+    nes::Disassembler disassembler(nes_emu);
+    disassembler.add_entry(0x0300);
+
+    // Both start out as BRKs
+    CHECK(find(disassembler.disassemble(), 0x0300).opcode == 0x00);
+    CHECK(find(disassembler.disassemble(), 0x6000).opcode == 0x00);
+
+    // Written by the program
+    nes_emu.run_until(20);
+    CHECK(find(disassembler.disassemble(), 0x0300).opcode == 0xE8);
+    CHECK(find(disassembler.disassemble(), 0x6000).opcode == 0xE8);
+
+    // Written by a debugger
+    nes_emu.poke(0x0300, 0xC8);
+    nes_emu.poke(0x6000, 0xC8);
+    CHECK(find(disassembler.disassemble(), 0x0300).opcode == 0xC8);
+    CHECK(find(disassembler.disassemble(), 0x6000).opcode == 0xC8);
+
+    // Brought back by a save state
+    std::vector<uint8_t> state(nes::Emulator::state_size);
+    nes_emu.poke(0x0300, 0xEA);
+    nes_emu.save_state(state.data());
+    nes_emu.poke(0x0300, 0x88);
+    CHECK(find(disassembler.disassemble(), 0x0300).opcode == 0x88);
+    CHECK(nes_emu.load_state(state.data()));
+    CHECK(find(disassembler.disassemble(), 0x0300).opcode == 0xEA);
+
+    // Program ROM patched by a cheat
+    CHECK(find(disassembler.disassemble(), 0x8000).opcode == 0xA9);
+    CHECK(nes_emu.add_cheat("8000:A2"));
+    CHECK(find(disassembler.disassemble(), 0x8000).opcode == 0xA2);
+    nes_emu.clear_cheats();
+    CHECK(find(disassembler.disassemble(), 0x8000).opcode == 0xA9);
+
+    // I/O and program RAM don't change RAM's version, so games don't have it
+    // traced again on every frame just for reading their controllers
+    image = nes_test::make_rom({
+        0xA9, 0x01,       // lda #$01
+        0x8D, 0x16, 0x40, // sta $4016
+        0xAD, 0x16, 0x40, // lda $4016
+        0x8D, 0x00, 0x60, // sta $6000
+        0x4C, 0x00, 0x80, // jmp $8000
+    });
+    CHECK(nes_emu.load_rom(image.data(), image.size()));
+    uint64_t ram_version = nes_emu.get_bank_version(0x0000);
+    uint64_t prg_ram_version = nes_emu.get_bank_version(0x6000);
+    nes_emu.run_until(1000);
+    CHECK(nes_emu.get_bank_version(0x0000) == ram_version);
+    CHECK(nes_emu.get_bank_version(0x6000) != prg_ram_version);
+
+    // Code in RAM and program RAM (some of it straddling two banks), reached
+    // from ROM and from each other, is randomly rewritten bit by bit (jump
+    // pointer included), and each time
+    // the listing must be the same as that of a new disassembler
+    image = nes_test::make_rom({
+        0x20, 0x00, 0x03, // jsr $0300
+        0x20, 0x00, 0x60, // jsr $6000
+        0x6C, 0xF0, 0x00, // jmp ($00F0)
+    });
+    for(int vector = 0x3FFA; vector < 0x4000; vector += 2) {
+        image[16 + vector] = 0x00;
+        image[16 + vector + 1] = 0x80;
+    }
+    CHECK(nes_emu.load_rom(image.data(), image.size()));
+    nes::Disassembler incremental(nes_emu);
+    incremental.add_entry(0x0310);
+    incremental.add_entry(0x6FFC);
+    // NOP, JMP, JMP (ind), JSR, BNE, RTS, LDA #, and parts of addresses
+    const uint8_t bytes[] = { 0xEA, 0x4C, 0x6C, 0x20, 0xD0, 0x60, 0xA9,
+        0x00, 0x03, 0x60, 0x80, 0xF0, 0x10, 0xFC };
+    std::mt19937 rng(89);
+    for(int i = 0; i < 2000; ++i) {
+        uint16_t addr;
+        switch(rng() % 4) {
+            case 0: addr = 0x0300 + rng() % 0x20; break;
+            case 1: addr = 0x6000 + rng() % 0x20; break;
+            case 2: addr = 0x6FFC + rng() % 8; break;
+            default: addr = 0x00F0 + rng() % 2; break;
+        }
+        nes_emu.poke(addr, bytes[rng() % sizeof(bytes)]);
+        nes::Disassembler fresh(nes_emu);
+        fresh.add_entry(0x0310);
+        fresh.add_entry(0x6FFC);
+        const std::vector<nes::Instruction> &got = incremental.disassemble();
+        const std::vector<nes::Instruction> &want = fresh.disassemble();
+        CHECK(got.size() == want.size());
+        for(size_t j = 0; j < got.size(); ++j)
+            CHECK(got[j].addr == want[j].addr && got[j].opcode == want[j].opcode
+                    && got[j].value() == want[j].value());
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include "check.hpp"
+#include "emulator.hpp"
+
+// Hooks adding and removing hooks, themselves included, from within a hook.
+// Worth running under AddressSanitizer, which is what caught these
+
+int main() {
+    std::vector<uint8_t> image = nes_test::make_rom({
+        0xE6, 0x00,       // inc $00
+        0x4C, 0x00, 0x80, // jmp $8000
+    });
+
+    // A frame hook that stops itself after a few frames, as the last hook
+    // there is, which drops the registry in the middle of the run
+    {
+        nes::Emulator nes_emu;
+        CHECK(nes_emu.load_rom(image.data(), image.size()));
+        int frames = 0, id = -1;
+        id = nes_emu.add_frame_hook([&](nes::Emulator &emu) {
+            if(++frames == 3) CHECK(emu.remove_hook(id));
+        });
+        CHECK(nes_emu.run_until(10 * nes_emu.get_frame_end()) > 0);
+        CHECK(frames == 3);
+        CHECK(nes_emu.get_frame() == 10);
+        CHECK(!nes_emu.remove_hook(id));
+    }
+
+    // An exec hook that removes another one on the same address, which must
+    // not fire anymore, and then itself
+    {
+        nes::Emulator nes_emu;
+        CHECK(nes_emu.load_rom(image.data(), image.size()));
+        int first = 0, second = 0, first_id = -1, second_id = -1;
+        first_id = nes_emu.add_exec_hook(0x8000, [&](nes::Emulator &emu, uint16_t) {
+            ++first;
+            CHECK(emu.remove_hook(second_id));
+            CHECK(emu.remove_hook(first_id));
+        });
+        second_id = nes_emu.add_exec_hook(0x8000, [&](nes::Emulator&, uint16_t) {
+            ++second;
+        });
+        nes_emu.run_frame();
+        CHECK(first == 1 && second == 0);
+    }
+
+    // A write hook that adds another one, which only fires from the next
+    // write on, and a frame hook removing both
+    {
+        nes::Emulator nes_emu;
+        CHECK(nes_emu.load_rom(image.data(), image.size()));
+        int writes = 0, added = 0, added_id = -1, write_id = -1;
+        write_id = nes_emu.add_write_hook(0x0000, [&](nes::Emulator &emu, uint16_t, uint8_t) {
+            if(++writes == 1) {
+                added_id = emu.add_write_hook(0x0000, [&](nes::Emulator&, uint16_t, uint8_t) {
+                    ++added;
+                });
+            }
+        });
+        nes_emu.add_frame_hook([&](nes::Emulator &emu) {
+            emu.remove_hook(write_id);
+            emu.remove_hook(added_id);
+        });
+        nes_emu.run_frame();
+        CHECK(writes > 1 && added == writes - 1);
+        int before = writes;
+        nes_emu.run_frame();
+        CHECK(writes == before);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "check.hpp"
+#include "emulator.hpp"
+#include "recompiler.hpp"
+#include "shared_code.hpp"
+
+// Native code together with cheats patching program ROM, which it must not
+// run blocks compiled from the ROM as it was before the patches for. Needs
+// the system's compiler, like the recompiler itself
+
+namespace {
+    // Run a patched instance using native code next to a patched one that
+    // only interprets, checking that they never part ways and that the patch
+    // took effect
+    void compare(nes::Emulator &native, nes::Emulator &interp, int frames) {
+        for(int i = 0; i < frames; ++i) {
+            native.run_frame();
+            interp.run_frame();
+            CHECK(nes_test::same_state(native, interp));
+        }
+        CHECK(native.peek(0x0001) == 0x02);
+    }
+}
+
+int main() {
+    std::vector<uint8_t> image = nes_test::make_rom({
+        0xE6, 0x00,       // inc $00
+        0xA9, 0x01,       // lda #$01, patched into lda #$02
+        0x85, 0x01,       // sta $01
+        0x4C, 0x00, 0x80, // jmp $8000
+    });
+    const char *cheat = "8003:02";
+
+    // Tiering enabled on an instance patched beforehand, while another
+    // instance of the ROM already shares code compiled from the unpatched
+    // loop
+    {
+        nes::Emulator warm;
+        CHECK(warm.load_rom(image.data(), image.size()));
+        if(!warm.enable_tiering(nes::default_compiler(), nes::default_include_dir()))
+            return 77; // Skipped, as far as meson test is concerned
+        std::shared_ptr<nes::SharedCode> shared = nes::SharedCode::get(warm.hash_prg_rom());
+        for(int i = 0; i < 3000 && !shared->find(0x8000); ++i) {
+            warm.run_frame();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK(shared->find(0x8000));
+
+        nes::Emulator native, interp;
+        CHECK(native.load_rom(image.data(), image.size()));
+        CHECK(interp.load_rom(image.data(), image.size()));
+        CHECK(native.add_cheat(cheat) && interp.add_cheat(cheat));
+        CHECK(native.enable_tiering(nes::default_compiler(), nes::default_include_dir()));
+        compare(native, interp, 60);
+    }
+
+    // A module compiled ahead of time, loaded into an instance patched
+    // beforehand
+    {
+        char dir[] = "/tmp/libre-nes-test-XXXXXX";
+        CHECK(mkdtemp(dir));
+        std::string module = std::string(dir) + "/aot.so";
+        nes_test::compile_aot(image, module);
+
+        nes::Emulator native, interp;
+        CHECK(native.load_rom(image.data(), image.size()));
+        CHECK(interp.load_rom(image.data(), image.size()));
+        CHECK(native.add_cheat(cheat) && interp.add_cheat(cheat));
+        CHECK(native.load_native(module));
+        compare(native, interp, 60);
+        remove(module.c_str());
+        rmdir(dir);
+    }
+    return EXIT_SUCCESS;
+}
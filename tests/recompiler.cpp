@@ -0,0 +1,237 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "check.hpp"
+#include "emulator.hpp"
+#include "opcodes.hpp"
+#include "recompiler.hpp"
+#include "shared_code.hpp"
+
+// The recompiler against the interpreter, on random programs built from the
+// instructions it handles: frame by frame, the two must be in the exact same
+// state, with code compiled ahead of time, on the fly, and on the fly with
+// shared code evicted all the time. Needs the system's compiler
+
+namespace {
+    const uint8_t op_jsr = 0x20, op_jmp = 0x4C, op_rts = 0x60, op_jmp_ind = 0x6C;
+
+    // Whether an opcode moves the stack around
+    bool is_stack(uint8_t op) {
+        return op == 0x08 || op == 0x28 || op == 0x48 || op == 0x68 || op == 0x9A;
+    }
+
+    // Whether an opcode changes Y, which counted loops count with
+    bool changes_y(uint8_t op) {
+        return op == 0x88 || op == 0xA0 || op == 0xA4 || op == 0xA8 || op == 0xAC
+            || op == 0xB4 || op == 0xBC || op == 0xC8;
+    }
+
+    // An address for an absolute operand: RAM, its mirrors, program RAM and
+    // ROM, or the controller port, which has side effects
+    uint16_t random_address(std::mt19937 &rng) {
+        switch(rng() % 5) {
+            case 0: return 0x0200 + rng() % 0x0600;
+            case 1: return rng() % 0x2000;
+            case 2: return 0x6000 + rng() % 0x2000;
+            case 3: return 0x8000 + rng() % 0x8000;
+            default: return 0x4016;
+        }
+    }
+
+    // Append a random instruction the recompiler handles, other than those
+    // moving the PC around. Stack instructions are rarer, unless they are
+    // left out altogether
+    void random_instruction(std::mt19937 &rng, std::vector<uint8_t> &code,
+            bool stack = true) {
+        static const std::vector<uint8_t> opcodes = [] {
+            std::vector<uint8_t> ops;
+            for(int op = 0; op < 256; ++op) {
+                nes::Addressing mode = nes::opcode_table[op].mode;
+                if(nes::can_recompile(op) && mode != nes::Addressing::Relative
+                        && op != op_jsr && op != op_jmp && op != op_rts
+                        && op != op_jmp_ind)
+                    ops.push_back(op);
+            }
+            return ops;
+        }();
+        uint8_t op;
+        do {
+            op = opcodes[rng() % opcodes.size()];
+        } while(is_stack(op) && (!stack || rng() % 10 < 7));
+        code.push_back(op);
+        uint8_t size = nes::operand_size(nes::opcode_table[op].mode);
+        if(size == 1) {
+            code.push_back(rng());
+        } else if(size == 2) {
+            uint16_t addr = random_address(rng);
+            code.push_back(addr & 0xFF);
+            code.push_back(addr >> 8);
+        }
+    }
+
+    // The program ROM of a random program, which sets up the stack and then
+    // loops forever through a few pieces of straight line code, each followed
+    // by a branch over a few instructions, a counted loop, a subroutine call
+    // or an indirect jump to the next instruction
+    std::vector<uint8_t> random_rom(uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> code = { 0xA2, 0xFF, 0x9A }; // ldx #$FF; txs
+        const uint16_t loop = 0x8000 + code.size();
+        // Where the JSRs' operands go, and the indirect jumps' targets, which
+        // are kept in a table at $BF00
+        std::vector<size_t> calls;
+        std::vector<uint16_t> targets;
+        for(int pieces = 3 + rng() % 7; pieces > 0; --pieces) {
+            for(int count = 1 + rng() % 11; count > 0; --count)
+                random_instruction(rng, code);
+            uint32_t kind = rng() % 10;
+            if(kind < 3) {
+                static const uint8_t branches[] = {
+                    0x10, 0x30, 0x50, 0x70, 0x90, 0xB0, 0xD0, 0xF0,
+                };
+                std::vector<uint8_t> skipped;
+                for(int count = 1 + rng() % 3; count > 0; --count)
+                    random_instruction(rng, skipped);
+                code.push_back(branches[rng() % 8]);
+                code.push_back(skipped.size());
+                code.insert(code.end(), skipped.begin(), skipped.end());
+            } else if(kind < 5) {
+                code.push_back(0xA0); // ldy #count
+                code.push_back(1 + rng() % 19);
+                size_t start = code.size();
+                for(int count = rng() % 3; count > 0; --count) {
+                    size_t at = code.size();
+                    random_instruction(rng, code);
+                    if(changes_y(code[at])) {
+                        code.resize(at);
+                        code.push_back(0xEA); // nop
+                    }
+                }
+                code.push_back(0x88); // dey
+                code.push_back(0xD0); // bne start
+                code.push_back(start - (code.size() + 1));
+            } else if(kind < 7) {
+                code.push_back(op_jsr);
+                calls.push_back(code.size());
+                code.resize(code.size() + 2);
+            } else {
+                uint16_t ptr = 0xBF00 + 2 * targets.size();
+                targets.push_back(0x8000 + code.size() + 3);
+                code.push_back(op_jmp_ind);
+                code.push_back(ptr & 0xFF);
+                code.push_back(ptr >> 8);
+            }
+        }
+        code.push_back(op_jmp);
+        code.push_back(loop & 0xFF);
+        code.push_back(loop >> 8);
+
+        // Subroutines leave the stack alone, so that they always return
+        for(size_t call : calls) {
+            uint16_t addr = 0x8000 + code.size();
+            code[call] = addr & 0xFF;
+            code[call + 1] = addr >> 8;
+            for(int count = 1 + rng() % 7; count > 0; --count)
+                random_instruction(rng, code, false);
+            code.push_back(op_rts);
+        }
+        code.resize(0x3F00, 0xEA);
+        for(uint16_t target : targets) {
+            code.push_back(target & 0xFF);
+            code.push_back(target >> 8);
+        }
+        return nes_test::make_rom(code);
+    }
+
+    // Run an instance next to one that only interprets for a frame, and
+    // check that they are still in the same state
+    void compare_frame(nes::Emulator &tested, nes::Emulator &interp,
+            const char *backend, uint32_t seed) {
+        uint64_t count = tested.run_frame();
+        if(count != interp.run_frame() || !nes_test::same_state(tested, interp)) {
+            fprintf(stderr, "ROM %u, %s: parted ways with the interpreter on frame %llu\n",
+                    seed, backend, static_cast<unsigned long long>(interp.get_frame()));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Run a ROM with tiered execution next to the interpreter, until the
+    // main loop got compiled and then some. Returns the shared code
+    std::shared_ptr<nes::SharedCode> compare_tiered(const std::vector<uint8_t> &image,
+            const char *backend, uint32_t seed) {
+        nes::Emulator tiered, interp;
+        CHECK(tiered.load_rom(image.data(), image.size()));
+        CHECK(interp.load_rom(image.data(), image.size()));
+        CHECK(tiered.enable_tiering(nes::default_compiler(), nes::default_include_dir()));
+        std::shared_ptr<nes::SharedCode> shared = nes::SharedCode::get(tiered.hash_prg_rom());
+        int frames = 0;
+        // Compiling is done in the background, so give it time
+        for(; frames < 3000 && !shared->find(0x8003); ++frames) {
+            compare_frame(tiered, interp, backend, seed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        CHECK(frames < 3000);
+        for(int i = 0; i < 60; ++i) {
+            compare_frame(tiered, interp, backend, seed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        return shared;
+    }
+}
+
+int main() {
+    char dir[] = "/tmp/libre-nes-test-XXXXXX";
+    CHECK(mkdtemp(dir));
+    const std::string module = std::string(dir) + "/aot.so";
+    const uint32_t roms = 12;
+
+    for(uint32_t seed = 0; seed < roms; ++seed) {
+        std::vector<uint8_t> image = random_rom(seed);
+        {
+            nes_test::compile_aot(image, module);
+            nes::Emulator native, interp;
+            CHECK(native.load_rom(image.data(), image.size()));
+            CHECK(interp.load_rom(image.data(), image.size()));
+            CHECK(native.load_native(module));
+            for(int i = 0; i < 60; ++i)
+                compare_frame(native, interp, "ahead of time", seed);
+            remove(module.c_str());
+        }
+        compare_tiered(image, "tiered", seed);
+    }
+
+    // Room for a couple of blocks only, so that modules keep getting evicted
+    // and compiled all over again
+    nes::SharedCode::set_capacity(2);
+    for(uint32_t seed = roms; seed < roms + 4; ++seed) {
+        std::shared_ptr<nes::SharedCode> shared = compare_tiered(random_rom(seed),
+                "tiered with evictions", seed);
+        CHECK(shared->evictions() > 0);
+    }
+
+    rmdir(dir);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+/*
+   Copyright 2023 Eduardo Antunes S. Vieira <eduardoantunes986@gmail.com>
+
+   This file is part of libre-nes.
+
+   libre-nes is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+
+   libre-nes is distributed in the hope that it will be useful, but WITHOUT ANY
+   WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+   FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along with
+   libre-nes. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "check.hpp"
+#include "emulator.hpp"
+#include "recorder.hpp"
+
+// What the recorders write: a YUV4MPEG2 stream with a frame for every frame
+// emulated, and a WAV file with as many samples as those frames last. Also
+// that the vectorized palette conversion matches the table lookups
+
+static std::vector<uint8_t> read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+// Read a little endian integer
+static uint32_t get(const std::vector<uint8_t> &data, size_t pos, int bytes) {
+    uint32_t value = 0;
+    for(int i = 0; i < bytes; ++i)
+        value |= data[pos + i] << (8 * i);
+    return value;
+}
+
+int main() {
+    std::vector<uint8_t> image = nes_test::make_rom({
+        0xE6, 0x00,       // inc $00
+        0x4C, 0x00, 0x80, // jmp $8000
+    });
+    char dir[] = "/tmp/libre-nes-test-XXXXXX";
+    CHECK(mkdtemp(dir));
+    std::string video_path = std::string(dir) + "/video.y4m";
+    std::string audio_path = std::string(dir) + "/audio.wav";
+
+    nes::Emulator nes_emu;
+    CHECK(nes_emu.load_rom(image.data(), image.size()));
+    CHECK(!nes_emu.record_video(std::string(dir) + "/missing/video.y4m"));
+    CHECK(nes_emu.record_video(video_path));
+    CHECK(nes_emu.record_audio(audio_path, 48000));
+    const int frames = 10;
+    for(int i = 0; i < frames; ++i)
+        nes_emu.run_frame();
+    nes_emu.stop_recording();
+    // Frames after that are not recorded
+    nes_emu.run_frame();
+
+    std::vector<uint8_t> video = read_file(video_path);
+    const char header[] = "YUV4MPEG2 W256 H240 F60099:1000 Ip A8:7 C444\n";
+    const size_t header_size = sizeof(header) - 1, pixels = 256 * 240;
+    const size_t frame_size = 6 + 3 * pixels;
+    CHECK(video.size() == header_size + frames * frame_size);
+    CHECK(std::memcmp(video.data(), header, header_size) == 0);
+    for(int i = 0; i < frames; ++i) {
+        const uint8_t *frame = video.data() + header_size + i * frame_size;
+        CHECK(std::memcmp(frame, "FRAME\n", 6) == 0);
+        // Black all over, in limited range BT.601
+        const uint8_t *planes = frame + 6;
+        CHECK(planes[0] == 16 && planes[pixels - 1] == 16);
+        CHECK(planes[pixels] == 128 && planes[3 * pixels - 1] == 128);
+    }
+
+    std::vector<uint8_t> audio = read_file(audio_path);
+    CHECK(audio.size() >= 44);
+    CHECK(std::memcmp(audio.data(), "RIFF", 4) == 0);
+    CHECK(std::memcmp(audio.data() + 8, "WAVEfmt ", 8) == 0);
+    CHECK(get(audio, 20, 2) == 1 && get(audio, 22, 2) == 1);
+    CHECK(get(audio, 24, 4) == 48000 && get(audio, 34, 2) == 16);
+    CHECK(std::memcmp(audio.data() + 36, "data", 4) == 0);
+    // 10 frames of 29781 cycles, at 1789773 cycles a second
+    const size_t samples = frames * 29781ull * 48000 / 1789773;
+    CHECK(audio.size() == 44 + 2 * samples);
+    for(size_t i = 44; i < audio.size(); ++i)
+        CHECK(audio[i] == 0);
+
+    remove(video_path.c_str());
+    remove(audio_path.c_str());
+    rmdir(dir);
+
+    // Every index value, in every position within a vector, and with runs
+    // of every length past the last whole vector
+    std::vector<uint8_t> indices(256 + 64);
+    for(size_t i = 0; i < indices.size(); ++i)
+        indices[i] = i;
+    for(size_t start = 0; start < 32; ++start) {
+        for(size_t count = 256; count <= 256 + 32; ++count) {
+            std::vector<uint8_t> want(3 * count), got(3 * count);
+            nes::palette_to_yuv_scalar(indices.data() + start, count,
+                    want.data(), want.data() + count, want.data() + 2 * count);
+            nes::palette_to_yuv(indices.data() + start, count,
+                    got.data(), got.data() + count, got.data() + 2 * count);
+            CHECK(got == want);
+        }
+    }
+    return EXIT_SUCCESS;
+}